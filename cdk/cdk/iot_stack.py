@@ -68,7 +68,8 @@ class IoTStack(Stack):
         device_log_group.grant_write(iot_logs_role)
 
         # IoT Topic Rule to route device logs to CloudWatch
-        # Devices publish to: device/{thingName}/logs
+        # Devices publish to: device/{thingName}/logs, batched as a JSON array
+        # of {"timestamp": <epoch ms>, "message": "<json log line>"}
         iot.CfnTopicRule(
             self,
             "DeviceLogsTopicRule",
@@ -80,7 +81,43 @@ class IoTStack(Stack):
                         cloudwatch_logs=iot.CfnTopicRule.CloudwatchLogsActionProperty(
                             log_group_name=device_log_group.log_group_name,
                             role_arn=iot_logs_role.role_arn,
-                            batch_mode=False,  # Stream logs immediately
+                            batch_mode=True,  # One log event per array entry
+                        )
+                    )
+                ],
+                rule_disabled=False,
+            ),
+        )
+
+        # CloudWatch Log Group for device metrics reports
+        device_metrics_log_group = logs.LogGroup(
+            self,
+            "DeviceMetricsLogGroup",
+            log_group_name=f"/aws/iot/foamer-{env_name}/metrics",
+            retention=logs.RetentionDays.ONE_MONTH
+            if env_name == "dev"
+            else logs.RetentionDays.THREE_MONTHS,
+            removal_policy=RemovalPolicy.DESTROY
+            if env_name == "dev"
+            else RemovalPolicy.RETAIN,
+        )
+
+        device_metrics_log_group.grant_write(iot_logs_role)
+
+        # IoT Topic Rule to route device metrics to CloudWatch
+        # Devices publish one JSON report every few minutes to:
+        # device/{thingName}/metrics
+        iot.CfnTopicRule(
+            self,
+            "DeviceMetricsTopicRule",
+            topic_rule_payload=iot.CfnTopicRule.TopicRulePayloadProperty(
+                sql="SELECT * FROM 'device/+/metrics'",
+                description="Route device metrics reports to CloudWatch Logs",
+                actions=[
+                    iot.CfnTopicRule.ActionProperty(
+                        cloudwatch_logs=iot.CfnTopicRule.CloudwatchLogsActionProperty(
+                            log_group_name=device_metrics_log_group.log_group_name,
+                            role_arn=iot_logs_role.role_arn,
                         )
                     )
                 ],
@@ -120,6 +157,8 @@ class IoTStack(Stack):
                         "Resource": [
                             # Allow publishing logs
                             f"arn:aws:iot:{self.region}:{self.account}:topic/device/${{iot:Connection.Thing.ThingName}}/logs",
+                            # Allow publishing metrics
+                            f"arn:aws:iot:{self.region}:{self.account}:topic/device/${{iot:Connection.Thing.ThingName}}/metrics",
                             # Allow publishing to shadow update topics
                             f"arn:aws:iot:{self.region}:{self.account}:topic/$aws/things/${{iot:Connection.Thing.ThingName}}/shadow/update",
                             # Allow publishing OTA job status
@@ -130,6 +169,8 @@ class IoTStack(Stack):
                         "Effect": "Allow",
                         "Action": ["iot:Subscribe"],
                         "Resource": [
+                            # Allow subscribing to pushed departures
+                            f"arn:aws:iot:{self.region}:{self.account}:topicfilter/device/${{iot:Connection.Thing.ThingName}}/departures",
                             # Allow subscribing to OTA job notifications
                             f"arn:aws:iot:{self.region}:{self.account}:topicfilter/$aws/things/${{iot:Connection.Thing.ThingName}}/jobs/*",
                             # Allow subscribing to shadow delta
@@ -140,6 +181,8 @@ class IoTStack(Stack):
                         "Effect": "Allow",
                         "Action": ["iot:Receive"],
                         "Resource": [
+                            # Allow receiving pushed departures
+                            f"arn:aws:iot:{self.region}:{self.account}:topic/device/${{iot:Connection.Thing.ThingName}}/departures",
                             # Allow receiving OTA job documents
                             f"arn:aws:iot:{self.region}:{self.account}:topic/$aws/things/${{iot:Connection.Thing.ThingName}}/jobs/*",
                             # Allow receiving shadow updates
@@ -1,7 +1,7 @@
 use anyhow::{Context, Result};
-use messages::Client as MessagesClient;
-use rand::seq::SliceRandom;
+use messages::{Client as MessagesClient, Message};
 use serde::{Deserialize, Serialize};
+use std::hash::{Hash, Hasher};
 use transit::TransitClient;
 
 use self::fmt::lines;
@@ -12,16 +12,20 @@ mod fmt;
 const DEFAULT_DISTANCE: u32 = 500;
 // this is LED display specificm luckily this is designed for n=1 device.
 const MAX_MESSAGE_WIDTH: usize = 16;
+// how long each stored message stays up before the next one takes over
+const MESSAGE_ROTATION_SECS: u64 = 10 * 60;
 
 type LatLon = (f32, f32);
 
-#[derive(Debug, Serialize, Deserialize)]
+/// Hashing covers what the board shows, leaving out what only changes as time
+/// passes, so the hash works as a cache validator across requests.
+#[derive(Debug, Hash, Serialize, Deserialize)]
 pub struct Departures {
     pub routes: Vec<Route>,
     pub message: Option<Vec<String>>,
 }
 
-#[derive(Debug, Serialize, Deserialize)]
+#[derive(Debug, Hash, Serialize, Deserialize)]
 pub struct Route {
     pub name: String,
     pub mode: String,
@@ -29,17 +33,116 @@ pub struct Route {
     pub directions: Vec<Direction>,
 }
 
-#[derive(Debug, Serialize, Deserialize)]
+#[derive(Debug, Hash, Serialize, Deserialize)]
 pub struct Direction {
     pub headsign: String,
     pub departures: Vec<Departure>,
 }
 
+/// `minutes` is relative to when the response was built; `at` is the absolute
+/// departure time (unix seconds) so clients can count down locally.
 #[derive(Debug, Serialize, Deserialize)]
-#[serde(tag = "type", content = "minutes")]
+#[serde(tag = "type")]
 pub enum Departure {
-    Scheduled(u16),
-    RealTime(u16),
+    Scheduled { minutes: u16, at: u64 },
+    RealTime { minutes: u16, at: u64 },
+}
+
+/// Hashes the kind and `at` only: `minutes` follows from `at` and ticks over
+/// every minute.
+impl Hash for Departure {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        match *self {
+            Departure::Scheduled { at, .. } => (0u8, at).hash(state),
+            Departure::RealTime { at, .. } => (1u8, at).hash(state),
+        }
+    }
+}
+
+/// The message up during the rotation slot that contains `now` (unix
+/// seconds). The same messages give the same pick for a whole slot.
+fn rotating_message(messages: &[Message], now: u64) -> Option<&Message> {
+    if messages.is_empty() {
+        return None;
+    }
+    let slot = now / MESSAGE_ROTATION_SECS;
+    messages.get((slot % messages.len() as u64) as usize)
+}
+
+/// Compact form of [`Departures`] for binary encodings (MessagePack).
+///
+/// Same shape and field names as the JSON so the device decodes both the same
+/// way, but the departure type is a byte and colors are packed `0xRRGGBB`.
+#[derive(Debug, Serialize)]
+pub struct CompactDepartures<'a> {
+    pub routes: Vec<CompactRoute<'a>>,
+    pub message: Option<&'a [String]>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct CompactRoute<'a> {
+    pub name: &'a str,
+    pub mode: &'a str,
+    pub color: u32,
+    pub directions: Vec<CompactDirection<'a>>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct CompactDirection<'a> {
+    pub headsign: &'a str,
+    pub departures: Vec<CompactDeparture>,
+}
+
+#[derive(Debug, Serialize)]
+pub struct CompactDeparture {
+    /// 0 = scheduled, 1 = real-time
+    #[serde(rename = "type")]
+    pub kind: u8,
+    pub minutes: u16,
+    pub at: u64,
+}
+
+impl<'a> From<&'a Departures> for CompactDepartures<'a> {
+    fn from(departures: &'a Departures) -> Self {
+        let routes = departures
+            .routes
+            .iter()
+            .map(|route| CompactRoute {
+                name: &route.name,
+                mode: &route.mode,
+                // Unparseable colors render black on the device either way
+                color: u32::from_str_radix(&route.color, 16).unwrap_or(0),
+                directions: route
+                    .directions
+                    .iter()
+                    .map(|direction| CompactDirection {
+                        headsign: &direction.headsign,
+                        departures: direction
+                            .departures
+                            .iter()
+                            .map(|departure| match *departure {
+                                Departure::Scheduled { minutes, at } => CompactDeparture {
+                                    kind: 0,
+                                    minutes,
+                                    at,
+                                },
+                                Departure::RealTime { minutes, at } => CompactDeparture {
+                                    kind: 1,
+                                    minutes,
+                                    at,
+                                },
+                            })
+                            .collect(),
+                    })
+                    .collect(),
+            })
+            .collect();
+
+        Self {
+            routes,
+            message: departures.message.as_deref(),
+        }
+    }
 }
 
 pub struct Client {
@@ -104,10 +207,11 @@ impl Client {
                                     return None;
                                 }
 
+                                let at = item.departure_time;
                                 Some(Ok(if item.is_real_time {
-                                    Departure::RealTime(minutes)
+                                    Departure::RealTime { minutes, at }
                                 } else {
-                                    Departure::Scheduled(minutes)
+                                    Departure::Scheduled { minutes, at }
                                 }))
                             })
                             .collect();
@@ -136,21 +240,129 @@ impl Client {
 
         let routes = routes?;
 
-        // Fetch a random message if available
+        // Rotate through the messages if there are any. Not picked at random,
+        // so an unchanged board keeps its ETag.
+        let now = std::time::SystemTime::now()
+            .duration_since(std::time::UNIX_EPOCH)
+            .context("Failed to get current time")?
+            .as_secs();
         let message = self
             .messages_client
             .list_all()
             .await
             .ok()
-            .and_then(|messages| {
-                if messages.is_empty() {
-                    None
-                } else {
-                    let mut rng = rand::thread_rng();
-                    messages.choose(&mut rng).map(|m| m.content.clone())
-                }
-            }).map(|x| lines(x, MAX_MESSAGE_WIDTH));
+            .and_then(|messages| rotating_message(&messages, now).map(|m| m.content.clone()))
+            .map(|x| lines(x, MAX_MESSAGE_WIDTH));
 
         Ok(Departures { routes, message })
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_compact_departures() {
+        let departures = Departures {
+            routes: vec![Route {
+                name: "Red".to_string(),
+                mode: "METRORail".to_string(),
+                color: "e41937".to_string(),
+                directions: vec![Direction {
+                    headsign: "Fannin South".to_string(),
+                    departures: vec![
+                        Departure::Scheduled {
+                            minutes: 4,
+                            at: 1_760_000_240,
+                        },
+                        Departure::RealTime {
+                            minutes: 12,
+                            at: 1_760_000_720,
+                        },
+                    ],
+                }],
+            }],
+            message: None,
+        };
+
+        let compact = CompactDepartures::from(&departures);
+        let route = &compact.routes[0];
+        assert_eq!(route.color, 0xe41937);
+        assert_eq!(route.directions[0].departures[0].kind, 0);
+        assert_eq!(route.directions[0].departures[1].kind, 1);
+        assert_eq!(route.directions[0].departures[1].minutes, 12);
+        assert_eq!(route.directions[0].departures[1].at, 1_760_000_720);
+    }
+
+    fn board_hash(departures: &Departures) -> u64 {
+        let mut hasher = std::hash::DefaultHasher::new();
+        departures.hash(&mut hasher);
+        hasher.finish()
+    }
+
+    fn board(minutes: u16, at: u64) -> Departures {
+        Departures {
+            routes: vec![Route {
+                name: "Red".to_string(),
+                mode: "METRORail".to_string(),
+                color: "e41937".to_string(),
+                directions: vec![Direction {
+                    headsign: "Fannin South".to_string(),
+                    departures: vec![Departure::RealTime { minutes, at }],
+                }],
+            }],
+            message: Some(vec!["HELLO".to_string()]),
+        }
+    }
+
+    #[test]
+    fn test_hash_ignores_minutes() {
+        // A minute later the same departure is a minute closer
+        assert_eq!(
+            board_hash(&board(5, 1_760_000_300)),
+            board_hash(&board(4, 1_760_000_300))
+        );
+        assert_ne!(
+            board_hash(&board(5, 1_760_000_300)),
+            board_hash(&board(5, 1_760_000_360))
+        );
+
+        let mut scheduled = board(5, 1_760_000_300);
+        scheduled.routes[0].directions[0].departures[0] = Departure::Scheduled {
+            minutes: 5,
+            at: 1_760_000_300,
+        };
+        assert_ne!(board_hash(&scheduled), board_hash(&board(5, 1_760_000_300)));
+    }
+
+    #[test]
+    fn test_message_rotation() {
+        let messages: Vec<Message> = ["one", "two", "three"]
+            .into_iter()
+            .map(|content| Message::new(content.to_string()))
+            .collect();
+        let slot_start = 1_760_000_400 / MESSAGE_ROTATION_SECS * MESSAGE_ROTATION_SECS;
+
+        // Steady within a slot, the next one in the next slot
+        let first = rotating_message(&messages, slot_start).unwrap();
+        let later = rotating_message(&messages, slot_start + MESSAGE_ROTATION_SECS - 1).unwrap();
+        assert_eq!(first.id, later.id);
+        let next = rotating_message(&messages, slot_start + MESSAGE_ROTATION_SECS).unwrap();
+        assert_ne!(first.id, next.id);
+
+        assert!(rotating_message(&[], slot_start).is_none());
+    }
+
+    #[test]
+    fn test_departure_json() {
+        let departure = Departure::RealTime {
+            minutes: 3,
+            at: 1_760_000_180,
+        };
+        assert_eq!(
+            serde_json::to_string(&departure).unwrap(),
+            r#"{"type":"RealTime","minutes":3,"at":1760000180}"#
+        );
+    }
+}
@@ -1,20 +1,26 @@
 use anyhow::{Context, Result};
-use api::{Client as FoamerClient, Departures};
+use api::{Client as FoamerClient, CompactDepartures, Departures};
 use axum::{
     Json, Router,
     extract::{Query, State},
-    http::{HeaderMap, Request, StatusCode},
+    http::{
+        HeaderMap, Request, StatusCode,
+        header::{ACCEPT, CONTENT_TYPE, ETAG, IF_NONE_MATCH, VARY},
+    },
     middleware::{self, Next},
     response::{IntoResponse, Response},
     routing::{get, post},
 };
 use messages::Client as MessagesClient;
 use serde::{Deserialize, Serialize};
+use std::hash::{DefaultHasher, Hash, Hasher};
 use std::sync::Arc;
 use tower_http::cors::CorsLayer;
 use tower_http::trace::TraceLayer;
 
 const MAX_MESSAGE_LEN: usize = 88;
+const MSGPACK: &str = "application/msgpack";
+const JSON: &str = "application/json";
 
 #[derive(Deserialize)]
 pub struct DeparturesQuery {
@@ -73,14 +79,113 @@ async fn auth_middleware(
 async fn get_departures(
     State(state): State<Arc<AppState>>,
     Query(params): Query<DeparturesQuery>,
-) -> Result<Json<Departures>, AppError> {
+    headers: HeaderMap,
+) -> Result<Response, AppError> {
     let coords = (params.lat, params.lon);
-    let departures = state
+    let departures: Departures = state
         .foamer_client
         .departures(&coords, params.max_distance)
         .await?;
 
-    Ok(Json(departures))
+    // Devices that ask for MessagePack get the compact encoding
+    let wants_msgpack = headers
+        .get(ACCEPT)
+        .and_then(|v| v.to_str().ok())
+        .is_some_and(prefers_msgpack);
+    let content_type = if wants_msgpack { MSGPACK } else { JSON };
+    let etag = etag(&departures, content_type);
+
+    // Devices send back the ETag of the data they hold; skip the body if unchanged
+    let not_modified = headers
+        .get(IF_NONE_MATCH)
+        .and_then(|v| v.to_str().ok())
+        .is_some_and(|v| none_match_hit(v, &etag));
+    if not_modified {
+        return Ok((
+            StatusCode::NOT_MODIFIED,
+            [(ETAG, etag), (VARY, ACCEPT.to_string())],
+        )
+            .into_response());
+    }
+
+    let body = if wants_msgpack {
+        rmp_serde::to_vec_named(&CompactDepartures::from(&departures))?
+    } else {
+        serde_json::to_vec(&departures)?
+    };
+    Ok((
+        [
+            (CONTENT_TYPE, content_type.to_string()),
+            (ETAG, etag),
+            (VARY, ACCEPT.to_string()),
+        ],
+        body,
+    )
+        .into_response())
+}
+
+/// Whether an Accept header asks for MessagePack: listed by name with a q
+/// above zero and at least JSON's. Wildcards only count for JSON, the default.
+fn prefers_msgpack(accept: &str) -> bool {
+    let msgpack = accept_quality(accept, MSGPACK, false).unwrap_or(0.0);
+    let json = accept_quality(accept, JSON, true).unwrap_or(0.0);
+    msgpack > 0.0 && msgpack >= json
+}
+
+/// q-value an Accept header gives `media_type`, or None if no range covers it.
+/// The most specific range wins; `type/*` and `*/*` count with `wildcards`.
+fn accept_quality(accept: &str, media_type: &str, wildcards: bool) -> Option<f32> {
+    let main_type = media_type.split('/').next().unwrap_or_default();
+    let mut best: Option<(u8, f32)> = None;
+    for entry in accept.split(',') {
+        let mut params = entry.split(';');
+        let range = params.next().unwrap_or_default().trim();
+        let specificity = if range.eq_ignore_ascii_case(media_type) {
+            2
+        } else if wildcards
+            && range
+                .strip_suffix("/*")
+                .is_some_and(|t| t.eq_ignore_ascii_case(main_type))
+        {
+            1
+        } else if wildcards && range == "*/*" {
+            0
+        } else {
+            continue;
+        };
+
+        // A q that doesn't parse is treated as absent
+        let q = params
+            .filter_map(|p| p.split_once('='))
+            .find(|(name, _)| name.trim().eq_ignore_ascii_case("q"))
+            .and_then(|(_, value)| value.trim().parse::<f32>().ok())
+            .unwrap_or(1.0);
+        if best.is_none_or(|(s, _)| specificity > s) {
+            best = Some((specificity, q));
+        }
+    }
+    best.map(|(_, q)| q)
+}
+
+/// Weak validator for departures in one encoding. It covers what the board
+/// shows but not the relative `minutes`, so bodies with the same tag can
+/// differ byte for byte.
+fn etag(departures: &Departures, content_type: &str) -> String {
+    let mut hasher = DefaultHasher::new();
+    content_type.hash(&mut hasher);
+    departures.hash(&mut hasher);
+    format!("W/\"{:016x}\"", hasher.finish())
+}
+
+/// Whether an If-None-Match header matches `etag`: `*`, or any listed tag
+/// under weak comparison (the `W/` prefixes don't count).
+fn none_match_hit(if_none_match: &str, etag: &str) -> bool {
+    let opaque = |tag: &str| {
+        let tag = tag.trim();
+        tag.strip_prefix("W/").unwrap_or(tag).to_string()
+    };
+    let etag = opaque(etag);
+    if_none_match.trim() == "*" || if_none_match.split(',').any(|tag| opaque(tag) == etag)
 }
 
 #[derive(Deserialize, Serialize)]
@@ -132,3 +237,48 @@ where
         Self(err.into())
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_none_match_hit() {
+        let etag = "W/\"00000000deadbeef\"";
+        assert!(none_match_hit(etag, etag));
+        assert!(none_match_hit("\"00000000deadbeef\"", etag));
+        assert!(none_match_hit(
+            "\"0000000000000001\", W/\"00000000deadbeef\"",
+            etag
+        ));
+        assert!(none_match_hit(" * ", etag));
+        assert!(!none_match_hit("\"0000000000000001\"", etag));
+        assert!(!none_match_hit("", etag));
+    }
+
+    #[test]
+    fn test_prefers_msgpack() {
+        // What the device sends
+        assert!(prefers_msgpack(
+            "application/msgpack, application/json;q=0.5"
+        ));
+        assert!(prefers_msgpack("application/msgpack"));
+        assert!(prefers_msgpack(
+            "application/json;q=0.9, application/msgpack"
+        ));
+
+        assert!(!prefers_msgpack(
+            "application/msgpack;q=0, application/json"
+        ));
+        assert!(!prefers_msgpack("application/msgpack; q=0"));
+        assert!(!prefers_msgpack(
+            "application/msgpack;q=0.5, application/json"
+        ));
+        assert!(!prefers_msgpack("application/msgpack;q=0.5, */*"));
+        assert!(!prefers_msgpack("*/*"));
+        assert!(!prefers_msgpack("application/*"));
+        assert!(!prefers_msgpack("application/json"));
+        assert!(!prefers_msgpack("application/msgpackx"));
+        assert!(!prefers_msgpack(""));
+    }
+}
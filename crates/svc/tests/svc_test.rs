@@ -134,3 +134,83 @@ async fn test_messages_too_long() -> Result<()> {
     assert_eq!(response.status(), StatusCode::BAD_REQUEST);
     Ok(())
 }
+
+#[tokio::test]
+async fn test_departures_etag() -> Result<()> {
+    let uri = "/departures?lat=29.72134736791465&lon=-95.38383198936232";
+    let app = svc::create_router().await?;
+
+    let response = app
+        .clone()
+        .oneshot(Request::builder().uri(uri).body(Body::empty())?)
+        .await?;
+    assert_eq!(response.status(), StatusCode::OK);
+    let etag = response
+        .headers()
+        .get("etag")
+        .expect("Response should carry an ETag")
+        .clone();
+
+    let response = app
+        .oneshot(
+            Request::builder()
+                .uri(uri)
+                .header("if-none-match", etag.clone())
+                .body(Body::empty())?,
+        )
+        .await?;
+
+    // The tag leaves out the ticking minutes and the message only rotates
+    // every few minutes, so the board is unchanged a moment later
+    assert_eq!(response.status(), StatusCode::NOT_MODIFIED);
+    assert_eq!(response.headers().get("etag"), Some(&etag));
+    let body = axum::body::to_bytes(response.into_body(), usize::MAX).await?;
+    assert!(body.is_empty(), "304 should not carry a body");
+
+    Ok(())
+}
+
+async fn departures_content_type(accept: &str) -> Result<String> {
+    let app = svc::create_router().await?;
+
+    let response = app
+        .oneshot(
+            Request::builder()
+                .uri("/departures?lat=29.72134736791465&lon=-95.38383198936232")
+                .header("accept", accept)
+                .body(Body::empty())?,
+        )
+        .await?;
+    assert_eq!(response.status(), StatusCode::OK);
+
+    Ok(response
+        .headers()
+        .get("content-type")
+        .expect("Response should carry a Content-Type")
+        .to_str()?
+        .to_string())
+}
+
+#[tokio::test]
+async fn test_departures_msgpack() -> Result<()> {
+    let content_type =
+        departures_content_type("application/msgpack, application/json;q=0.5").await?;
+    assert_eq!(content_type, "application/msgpack");
+    Ok(())
+}
+
+#[tokio::test]
+async fn test_departures_json_fallback() -> Result<()> {
+    // MessagePack is acceptable but JSON is preferred
+    let content_type =
+        departures_content_type("application/msgpack;q=0.5, application/json").await?;
+    assert_eq!(content_type, "application/json");
+    Ok(())
+}
+
+#[tokio::test]
+async fn test_departures_msgpack_refused() -> Result<()> {
+    let content_type = departures_content_type("application/msgpack;q=0, application/json").await?;
+    assert_eq!(content_type, "application/json");
+    Ok(())
+}
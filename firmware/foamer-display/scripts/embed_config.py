@@ -1,8 +1,10 @@
 #!/usr/bin/env python3
 """
 Build script to embed JSON config profile and splash image into firmware.
-Reads config from firmware/profiles/{PROFILE}.json and generates src/config_data.h
-Processes static/transit-logo.png and generates src/splash.h
+Reads config from firmware/profiles/{PROFILE}.json, checks it and generates
+src/config_data.h with the settings as a typed constexpr ConfigData
+Compresses static/transit-logo.png (the splash) and static/icons/*.png into
+src/assets.h
 """
 
 import json
@@ -70,33 +72,160 @@ if device_serial:
         # Merge device config into aws_iot section
         config_data["aws_iot"]["thing_name"] = device_config["thing_name"]
         config_data["aws_iot"]["log_topic"] = device_config["log_topic"]
+        config_data["aws_iot"]["departures_topic"] = device_config.get(
+            "departures_topic", f"device/{device_config['thing_name']}/departures"
+        )
         config_data["aws_iot"]["cert_pem"] = cert_pem
         config_data["aws_iot"]["private_key"] = private_key
         config_data["aws_iot"]["root_ca"] = root_ca
 
         log(f"  thing_name: {device_config['thing_name']}")
         log(f"  log_topic: {device_config['log_topic']}")
+        log(f"  departures_topic: {config_data['aws_iot']['departures_topic']}")
         log(f"  certificates loaded from {device_dir}")
     elif aws_iot_enabled:
         log(f"WARNING: AWS IoT enabled but device config not found: {device_dir}")
-        log(f"Run: make provision to create device configuration")
     else:
         log("AWS IoT disabled in profile, skipping device config")
 else:
     log("device serial: None")
 
-# re-serialize to ensure valid JSON
-config_json = json.dumps(config_data)
 
-# Generate header file with embedded JSON
+class ConfigError(Exception):
+    pass
+
+
+def lookup(path: str):
+    """Value at a dotted path in the config, or None if absent"""
+    value = config_data
+    for key in path.split("."):
+        if not isinstance(value, dict) or key not in value:
+            return None
+        value = value[key]
+    return value
+
+
+def c_string(value: str) -> str:
+    """C string literal, split after each newline so PEMs stay readable"""
+    lines = []
+    literal = ""
+    for byte in value.encode("utf-8"):
+        char = chr(byte)
+        if char == "\n":
+            literal += "\\n"
+            lines.append(literal)
+            literal = ""
+        elif char in '"\\':
+            literal += "\\" + char
+        elif 0x20 <= byte < 0x7F:
+            literal += char
+        else:
+            literal += f"\\{byte:03o}"
+    if literal or not lines:
+        lines.append(literal)
+    return "\n    ".join(f'"{line}"' for line in lines)
+
+
+def string_field(path: str, required: bool = True) -> str:
+    value = lookup(path)
+    if value is None and not required:
+        return "nullptr"
+    if not isinstance(value, str) or not value:
+        raise ConfigError(f"missing or invalid {path} (expected a string)")
+    return c_string(value)
+
+
+def int_field(path: str, default: int | None = None) -> str:
+    value = lookup(path)
+    if value is None and default is not None:
+        value = default
+    if not isinstance(value, int) or isinstance(value, bool) or value < 0:
+        raise ConfigError(f"missing or invalid {path} (expected an integer)")
+    return str(value)
+
+
+def bool_field(path: str, default: bool) -> str:
+    value = lookup(path)
+    if value is None:
+        value = default
+    if not isinstance(value, bool):
+        raise ConfigError(f"invalid {path} (expected true or false)")
+    return "true" if value else "false"
+
+
+# Names of the profiles in src/display_profile.cpp
+DISPLAY_PROFILES = ("full", "balanced", "flat")
+
+
+def choice_field(path: str, choices: tuple[str, ...], default: str) -> str:
+    value = lookup(path)
+    if value is None:
+        value = default
+    if value not in choices:
+        raise ConfigError(f"invalid {path} (expected one of {', '.join(choices)})")
+    return c_string(value)
+
+
+aws_iot_enabled = lookup("aws_iot.enabled") is True
+pem_arrays = []
+
+
+def pem_field(path: str, name: str) -> str:
+    """PEM blob as its own static const array, which stays in flash"""
+    if not aws_iot_enabled:
+        return "nullptr"
+    pem_arrays.append(f"static const char {name}[] =\n    {string_field(path)};\n")
+    return name
+
+
+# Same order as ConfigData in src/config.h
+try:
+    fields = [
+        ("wifiSsid", string_field("wifi.ssid")),
+        ("wifiPassword", string_field("wifi.password")),
+        ("wifiReuseLease", bool_field("wifi.reuse_lease", False)),
+        ("apiUrl", string_field("api.url")),
+        ("apiSecret", string_field("api.secret")),
+        ("geoLat", string_field("geo.lat")),
+        ("geoLon", string_field("geo.lon")),
+        ("pageIntervalMs", int_field("display.page_ms")),
+        ("messageIntervalMs", int_field("display.message_interval_ms")),
+        ("displayProfile", choice_field("display.profile", DISPLAY_PROFILES, "full")),
+        ("pollMinMs", int_field("polling.min_ms", 30000)),
+        ("pollMaxMs", int_field("polling.max_ms", 300000)),
+        ("pollRealtimeMs", int_field("polling.realtime_ms", 60000)),
+        ("pollRetryMs", int_field("polling.retry_ms", 10000)),
+        ("pollBackoffMaxMs", int_field("polling.backoff_max_ms", 600000)),
+        ("awsIotEnabled", "true" if aws_iot_enabled else "false"),
+        ("awsIotEndpoint", string_field("aws_iot.endpoint", aws_iot_enabled)),
+        ("awsIotThingName", string_field("aws_iot.thing_name", aws_iot_enabled)),
+        ("awsIotLogTopic", string_field("aws_iot.log_topic", aws_iot_enabled)),
+        ("awsIotDeparturesTopic", string_field("aws_iot.departures_topic", False)),
+        ("metricsIntervalMs", int_field("aws_iot.metrics_interval_ms", 300000)),
+        ("awsIotCertPem", pem_field("aws_iot.cert_pem", "AWS_IOT_CERT_PEM")),
+        ("awsIotPrivateKey", pem_field("aws_iot.private_key", "AWS_IOT_PRIVATE_KEY")),
+        ("awsIotRootCa", pem_field("aws_iot.root_ca", "AWS_IOT_ROOT_CA")),
+    ]
+except ConfigError as e:
+    log(f"ERROR: {config_file}: {e}")
+    if aws_iot_enabled and "aws_iot." in str(e):
+        log("Run: make provision to create device configuration")
+    sys.exit(1)
+
+pem_block = "".join(array + "\n" for array in pem_arrays)
+initializers = "".join(f"    /* {name} */ {value},\n" for name, value in fields)
+
+# Generate header file with the typed config
 header_content = f"""// AUTO-GENERATED FILE - DO NOT EDIT
 // Generated from profile: {profile}
 // Source: {config_file}
+// Included by config.h, which defines ConfigData
 
 #ifndef CONFIG_DATA_H
 #define CONFIG_DATA_H
 
-const char* CONFIG_JSON = R"({config_json})";
+{pem_block}constexpr ConfigData CONFIG_DATA = {{
+{initializers}}};
 
 #endif // CONFIG_DATA_H
 """
@@ -106,76 +235,135 @@ with output_file.open("w") as f:
     f.write(header_content)
 log(f"generated: {output_file}")
 
-# Process splash image
-splash_input = project_dir / "static" / "transit-logo.png"
-splash_output = project_dir / "src" / "splash.h"
-
-log(f"processing splash image: {splash_input}")
-
-img = Image.open(splash_input)
-img = img.convert("RGB")
-
-# Scale to fit 96x48 display (centered)
+# Asset pipeline: every image becomes a palette of up to 256 RGB565 colors
+# and per-row runs of (count, palette index) bytes; see src/asset.h
 display_width = 96
 display_height = 48
-
-# Calculate scaling to fit the circle into the display with padding
-# Leave 2-3px margin on top and bottom, then scale down by 15%
-target_height = (display_height - 4) * 0.85  # ~37px with extra margin
-scale_factor = target_height / img.height
-new_size = (int(img.width * scale_factor), int(img.height * scale_factor))
-img = img.resize(new_size, Image.Resampling.LANCZOS)
-
-# Center horizontally and vertically
-x_offset = (display_width - new_size[0]) // 2
-y_offset = (display_height - new_size[1]) // 2
-
-# Convert to RGB565 and generate C array
-pixels = []
-for y in range(display_height):
-    for x in range(display_width):
-        if (
-            x < x_offset
-            or x >= x_offset + new_size[0]
-            or y < y_offset
-            or y >= y_offset + new_size[1]
-        ):
-            # Black padding
-            pixels.append(0x0000)
-        else:
-            r, g, b = img.getpixel((x - x_offset, y - y_offset))
-            # Convert to RGB565: 5 bits red, 6 bits green, 5 bits blue
-            rgb565 = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
-            pixels.append(rgb565)
-
-# Generate splash header
-splash_header = f"""// AUTO-GENERATED FILE - DO NOT EDIT
-// Generated from: {splash_input}
-
-#ifndef SPLASH_H
-#define SPLASH_H
-
-#include <stdint.h>
-
-const uint16_t SPLASH_WIDTH = {display_width};
-const uint16_t SPLASH_HEIGHT = {display_height};
-
-const uint16_t SPLASH_BITMAP[{display_width * display_height}] = {{
+max_palette = 256
+
+
+def rgb565_pixels(img) -> list[int]:
+    return [
+        ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
+        for r, g, b in img.getdata()
+    ]
+
+
+def load_pixels(img, name: str) -> list[int]:
+    """RGB565 pixels, reduced to max_palette colors if there are more"""
+    img = img.convert("RGB")
+    pixels = rgb565_pixels(img)
+    colors = len(set(pixels))
+    if colors > max_palette:
+        log(f"  {name}: quantizing {colors} colors to {max_palette}")
+        img = img.quantize(
+            colors=max_palette,
+            method=Image.Quantize.MEDIANCUT,
+            dither=Image.Dither.NONE,
+        ).convert("RGB")
+        pixels = rgb565_pixels(img)
+    return pixels
+
+
+def encode_asset(name: str, pixels: list[int], width: int, height: int) -> str:
+    """C arrays and the Asset for one image"""
+    palette = []
+    palette_index = {}
+    runs = []
+    for y in range(height):
+        row = pixels[y * width : (y + 1) * width]
+        x = 0
+        while x < width:
+            color = row[x]
+            count = 1
+            while x + count < width and row[x + count] == color and count < 255:
+                count += 1
+            if color not in palette_index:
+                palette_index[color] = len(palette)
+                palette.append(color)
+            runs += [count, palette_index[color]]
+            x += count
+
+    raw_bytes = width * height * 2
+    flash_bytes = len(palette) * 2 + len(runs)
+    log(
+        f"  {name}: {width}x{height}, {len(palette)} colors, "
+        f"{raw_bytes} -> {flash_bytes} bytes"
+    )
+
+    def rows_of(values, per_row, fmt):
+        lines = []
+        for i in range(0, len(values), per_row):
+            lines.append("    " + ", ".join(fmt(v) for v in values[i : i + per_row]))
+        return ",\n".join(lines)
+
+    return f"""// {name}: {raw_bytes} bytes as raw RGB565
+const uint16_t {name}_PALETTE[{len(palette)}] = {{
+{rows_of(palette, 8, lambda v: f"0x{v:04X}")}
+}};
+
+const uint8_t {name}_RUNS[{len(runs)}] = {{
+{rows_of(runs, 16, str)}
+}};
+
+const uint32_t {name}_FLASH_BYTES = {flash_bytes};
+const Asset {name} = {{{width}, {height}, {name}_PALETTE, {name}_RUNS}};
 """
 
-# Write pixels in rows of 12 for readability
-for i in range(0, len(pixels), 12):
-    row = pixels[i : i + 12]
-    splash_header += "  " + ", ".join(f"0x{p:04X}" for p in row)
-    if i + 12 < len(pixels):
-        splash_header += ","
-    splash_header += "\n"
 
-splash_header += """};
+def splash_pixels(path: Path) -> list[int]:
+    """The logo scaled into the middle of a black full-panel image"""
+    img = Image.open(path).convert("RGB")
+
+    # Leave 2-3px margin on top and bottom, then scale down by 15%
+    target_height = (display_height - 4) * 0.85  # ~37px with extra margin
+    scale_factor = target_height / img.height
+    new_size = (int(img.width * scale_factor), int(img.height * scale_factor))
+    img = img.resize(new_size, Image.Resampling.LANCZOS)
+
+    # Center horizontally and vertically
+    splash = Image.new("RGB", (display_width, display_height))
+    x_offset = (display_width - new_size[0]) // 2
+    y_offset = (display_height - new_size[1]) // 2
+    splash.paste(img, (x_offset, y_offset))
+    return load_pixels(splash, "SPLASH")
+
+
+assets_output = project_dir / "src" / "assets.h"
+static_dir = project_dir / "static"
+
+log("compressing assets:")
+asset_sources = [
+    encode_asset(
+        "SPLASH",
+        splash_pixels(static_dir / "transit-logo.png"),
+        display_width,
+        display_height,
+    )
+]
+
+# Icons and glyphs are used at their own size, named ICON_<FILE NAME>
+for icon in sorted((static_dir / "icons").glob("*.png")):
+    name = "ICON_" + icon.stem.upper().replace("-", "_")
+    img = Image.open(icon)
+    asset_sources.append(
+        encode_asset(name, load_pixels(img, name), img.width, img.height)
+    )
+
+asset_block = "\n".join(asset_sources)
+assets_header = f"""// AUTO-GENERATED FILE - DO NOT EDIT
+// Generated from: {static_dir}
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include "asset.h"
+#include <stdint.h>
 
-#endif // SPLASH_H
+{asset_block}
+#endif // ASSETS_H
 """
 
-with splash_output.open("w") as f:
-    f.write(splash_header)
-log(f"generated: {splash_output}")
+with assets_output.open("w") as f:
+    f.write(assets_header)
+log(f"generated: {assets_output}")
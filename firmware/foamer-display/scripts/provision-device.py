@@ -35,6 +35,7 @@ def provision_device(serial_number: str, profile: str):
     # Thing name format: foamer-{profile}-{serial}
     thing_name = f"foamer-{profile}-{serial_normalized}"
     log_topic = f"device/{thing_name}/logs"
+    departures_topic = f"device/{thing_name}/departures"
 
     print(f"Provisioning device: {thing_name}")
     print(f"USB Serial: {serial_number}")
@@ -99,6 +100,7 @@ def provision_device(serial_number: str, profile: str):
     device_config = {
         "thing_name": thing_name,
         "log_topic": log_topic,
+        "departures_topic": departures_topic,
         "certificate_arn": cert_arn,
     }
 
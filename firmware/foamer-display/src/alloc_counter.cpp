@@ -0,0 +1,64 @@
+#ifdef ALLOC_COUNTER
+
+#include "alloc_counter.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stddef.h>
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+}
+
+static const int MAX_TASKS = 4;
+static TaskHandle_t tasks[MAX_TASKS];
+static volatile uint32_t counts[MAX_TASKS]; // Each only written by its task
+
+static int taskSlot(TaskHandle_t task) {
+  for (int i = 0; i < MAX_TASKS; i++) {
+    if (task && tasks[i] == task) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void countAllocation() {
+  int slot = taskSlot(xTaskGetCurrentTaskHandle());
+  if (slot >= 0) {
+    counts[slot]++;
+  }
+}
+
+extern "C" void *__wrap_malloc(size_t size) {
+  countAllocation();
+  return __real_malloc(size);
+}
+
+extern "C" void *__wrap_calloc(size_t count, size_t size) {
+  countAllocation();
+  return __real_calloc(count, size);
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size) {
+  countAllocation();
+  return __real_realloc(ptr, size);
+}
+
+void allocTrackTask() {
+  TaskHandle_t current = xTaskGetCurrentTaskHandle();
+  for (int i = 0; i < MAX_TASKS; i++) {
+    if (!tasks[i] || tasks[i] == current) {
+      tasks[i] = current;
+      return;
+    }
+  }
+}
+
+uint32_t allocCount() {
+  int slot = taskSlot(xTaskGetCurrentTaskHandle());
+  return slot >= 0 ? counts[slot] : 0;
+}
+
+#endif // ALLOC_COUNTER
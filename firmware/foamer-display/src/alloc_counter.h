@@ -0,0 +1,21 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stdint.h>
+
+// Heap allocations (malloc, calloc and realloc, so also new and String) made
+// by a task. Only counted in the alloc_debug build, which defines
+// ALLOC_COUNTER and wraps those functions at link time; in other builds
+// allocCount() is always 0 and the calls compile away.
+#ifdef ALLOC_COUNTER
+// Start counting the calling task's allocations (up to four tasks)
+void allocTrackTask();
+
+// Allocations made by the calling task so far, 0 if it isn't tracked
+uint32_t allocCount();
+#else
+inline void allocTrackTask() {}
+inline uint32_t allocCount() { return 0; }
+#endif
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,66 @@
+#ifndef API_CONNECTION_H
+#define API_CONNECTION_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+
+// Connection details for the most recent request
+struct FetchStats {
+  bool reused;        // true if an already-open connection carried the request
+  uint32_t dnsMs;     // Host name lookup, 0 when reused
+  uint32_t connectMs; // TCP connect + TLS handshake, 0 when reused
+  uint32_t requestMs; // request sent until response headers parsed
+};
+
+// Long-lived connection to the API server.
+// Keeps one TCP/TLS connection open across requests with HTTP/1.1 keep-alive
+// and reconnects transparently when the server has closed it.
+class ApiConnection {
+public:
+  // baseUrl is scheme://host[:port] without a trailing slash
+  bool begin(const char *baseUrl, const char *apiKey);
+
+  // Media types sent as the Accept header of every request, e.g.
+  // "application/msgpack, application/json;q=0.5"
+  void setAccept(const char *mediaTypes) { accept = mediaTypes; }
+
+  // Send a GET for path (starting with "/"). Returns the HTTP status code or
+  // a negative HTTPC_ERROR_* value. Call end() once the body has been read.
+  // etag / lastModified are validators from a previous response; when given
+  // they are sent as If-None-Match / If-Modified-Since and the server may
+  // answer 304 Not Modified.
+  int get(const char *path, const char *etag = nullptr,
+          const char *lastModified = nullptr);
+
+  // Response access (getStream(), getString(), getSize(), header("ETag"),
+  // header("Last-Modified"), header("Content-Type")) after get()
+  HTTPClient &http() { return httpClient; }
+
+  // Finish the current request, keeping the connection open if the server
+  // allows it
+  void end();
+
+  // Drop the connection, e.g. after a network change
+  void close();
+
+  const FetchStats &stats() const { return lastStats; }
+
+private:
+  // Open the socket ourselves so the lookup and handshake can be timed
+  // separately; HTTPClient then sees a connected client and reuses it
+  bool connect();
+  int sendGet(const char *etag, const char *lastModified);
+
+  WiFiClient *client = nullptr; // WiFiClientSecure for https
+  HTTPClient httpClient;
+  String baseUrl;
+  String host;
+  uint16_t port = 0;
+  const char *apiKey = nullptr;
+  const char *accept = nullptr;
+  char url[256]; // baseUrl + path of the current request
+  FetchStats lastStats = {};
+};
+
+#endif // API_CONNECTION_H
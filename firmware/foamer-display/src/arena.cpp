@@ -0,0 +1,82 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+void ArenaAllocator::begin(void *buffer, size_t size) {
+  // Align the start, the end only needs to hold whole blocks
+  size_t skip = roundUp((size_t)buffer) - (size_t)buffer;
+  base = static_cast<char *>(buffer) + skip;
+  limit = size > skip ? size - skip : 0;
+  reset();
+}
+
+size_t ArenaAllocator::blockSize(const void *ptr) const {
+  size_t size;
+  memcpy(&size, static_cast<const char *>(ptr) - ALIGN, sizeof(size));
+  return size;
+}
+
+void ArenaAllocator::setBlockSize(void *ptr, size_t size) {
+  memcpy(static_cast<char *>(ptr) - ALIGN, &size, sizeof(size));
+}
+
+void *ArenaAllocator::allocate(size_t size) {
+  if (!base) {
+    return malloc(size);
+  }
+
+  size_t need = ALIGN + roundUp(size);
+  if (need > limit - top) {
+    return nullptr; // ArduinoJson reports NoMemory
+  }
+
+  void *ptr = base + top + ALIGN;
+  setBlockSize(ptr, size);
+  last = top;
+  top += need;
+  return ptr;
+}
+
+void ArenaAllocator::deallocate(void *ptr) {
+  if (!base) {
+    free(ptr);
+    return;
+  }
+
+  // Only the most recent block can be given back
+  if (ptr && last != NO_BLOCK && ptr == base + last + ALIGN) {
+    top = last;
+    last = NO_BLOCK;
+  }
+}
+
+void *ArenaAllocator::reallocate(void *ptr, size_t size) {
+  if (!base) {
+    return realloc(ptr, size);
+  }
+  if (!ptr) {
+    return allocate(size);
+  }
+
+  // The most recent block grows or shrinks in place
+  if (last != NO_BLOCK && ptr == base + last + ALIGN) {
+    size_t need = ALIGN + roundUp(size);
+    if (need > limit - last) {
+      return nullptr;
+    }
+    setBlockSize(ptr, size);
+    top = last + need;
+    return ptr;
+  }
+
+  // Older blocks keep their space when shrinking and move when growing
+  size_t oldSize = blockSize(ptr);
+  if (size <= oldSize) {
+    return ptr;
+  }
+  void *moved = allocate(size);
+  if (moved) {
+    memcpy(moved, ptr, oldSize);
+  }
+  return moved;
+}
@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+
+// ArduinoJson allocator handing out memory from one fixed buffer (PSRAM on
+// the device) by bumping an offset. Nothing is freed individually: reset()
+// drops everything at once, so call it before each parse while no document
+// using the arena is alive. Allocation is O(1) and the buffer can't
+// fragment. Growing or freeing the most recent block (ArduinoJson's string
+// builder and its final shrink-to-fit) happens in place.
+// Without a buffer from begin() it passes everything through to the heap.
+class ArenaAllocator : public ArduinoJson::Allocator {
+public:
+  // Use size bytes at buffer, owned by the caller
+  void begin(void *buffer, size_t size);
+
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t size) override;
+
+  void reset() {
+    top = 0;
+    last = NO_BLOCK;
+  }
+
+  bool hasBuffer() const { return base != nullptr; }
+  size_t capacity() const { return limit; }
+  size_t used() const { return top; }
+
+private:
+  // Every block starts on ALIGN and is preceded by a header of ALIGN bytes
+  // holding its size
+  static const size_t ALIGN = 8;
+  static const size_t NO_BLOCK = ~(size_t)0;
+
+  static size_t roundUp(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+  size_t blockSize(const void *ptr) const;
+  void setBlockSize(void *ptr, size_t size);
+
+  char *base = nullptr;
+  size_t limit = 0;
+  size_t top = 0;          // Offset of the first free byte
+  size_t last = NO_BLOCK;  // Offset of the most recent block's header
+};
+
+#endif // ARENA_H
@@ -0,0 +1,30 @@
+#include "asset.h"
+
+void blitAsset(const Asset &asset, uint16_t *buffer, int16_t width,
+               int16_t height, int16_t x, int16_t y) {
+  const uint8_t *run = asset.runs;
+  int16_t left = x < 0 ? 0 : x;
+  int16_t right = x + asset.width > width ? width : x + asset.width;
+
+  for (int row = 0; row < asset.height; row++) {
+    int16_t rowY = y + row;
+    bool visible = rowY >= 0 && rowY < height;
+    uint16_t *line = buffer + (int32_t)rowY * width;
+
+    // Walk this row's runs even when it is clipped, to find the next row
+    int16_t runX = x;
+    for (int filled = 0; filled < asset.width; run += 2) {
+      uint8_t count = run[0];
+      filled += count;
+      if (visible) {
+        uint16_t color = asset.palette[run[1]];
+        int16_t start = runX < left ? left : runX;
+        int16_t end = runX + count > right ? right : runX + count;
+        for (int16_t i = start; i < end; i++) {
+          line[i] = color;
+        }
+      }
+      runX += count;
+    }
+  }
+}
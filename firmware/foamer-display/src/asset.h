@@ -0,0 +1,22 @@
+#ifndef ASSET_H
+#define ASSET_H
+
+#include <stdint.h>
+
+// Image compressed into flash by scripts/embed_config.py (see assets.h).
+// Pixels are palette indices, run-length encoded row by row as
+// (count, index) byte pairs; a run never spans two rows.
+struct Asset {
+  uint16_t width;
+  uint16_t height;
+  const uint16_t *palette; // RGB565
+  const uint8_t *runs;
+};
+
+// Decode asset a row at a time into a width x height RGB565 frame buffer
+// with its top-left corner at (x, y). Each run is a straight fill of the
+// row; anything outside the buffer is clipped.
+void blitAsset(const Asset &asset, uint16_t *buffer, int16_t width,
+               int16_t height, int16_t x, int16_t y);
+
+#endif // ASSET_H
@@ -2,78 +2,204 @@
 #define AWS_IOT_H
 
 #include "config.h"
+#include "log.h"
+#include "metrics.h"
+#include "reconnect.h"
 #include <Arduino.h>
-#include <ArduinoJson.h>
 #include <PubSubClient.h>
 #include <WiFiClientSecure.h>
 
-// Log levels
-const char* LOG_DEBUG = "DEBUG";
-const char* LOG_INFO = "INFO";
-const char* LOG_WARN = "WARNING";
-const char* LOG_ERROR = "ERROR";
-
 // Global MQTT client pointer (defined at bottom of file)
 extern PubSubClient *mqttClient;
 
-// Initialize AWS IoT connection
-// Returns true if enabled and initialized successfully
+// Its TLS connection, opened on its own before the MQTT CONNECT so the two
+// blocking steps run in separate mqtt job runs
+extern WiFiClientSecure *mqttTransport;
+
+// Reconnect state and backoff of the MQTT connection
+extern Reconnector *mqttLink;
+
+const uint16_t AWS_IOT_PORT = 8883;
+
+// Retry after a failed connect in 1 s, doubling up to a minute, rather than
+// on every mqtt job run
+const BackoffBounds MQTT_BACKOFF = {1000, 60000};
+
+// Upper bounds on the TLS handshake and on waiting for CONNACK, in seconds
+const uint32_t MQTT_HANDSHAKE_TIMEOUT_S = 10;
+const uint16_t MQTT_CONNACK_TIMEOUT_S = 5;
+
+// PubSubClient receives into this buffer and silently drops any message that
+// does not fit, so it has to hold a whole departures snapshot, not just logs
+const uint16_t MQTT_BUFFER_SIZE = 16384;
+
+// Called from maintainAwsIotConnection() with each snapshot pushed to the
+// departures topic. The payload is only valid for the duration of the call.
+typedef void (*DeparturesHandler)(const byte *payload, unsigned int length);
+extern DeparturesHandler departuresHandler;
+
+// Set the handler for pushed departures (nullptr ignores them)
+void setDeparturesHandler(DeparturesHandler handler);
+
+// Set up the AWS IoT client without connecting, so boot doesn't wait for
+// the TLS handshake. Returns true if enabled.
 bool setupAwsIot();
 
-// Check if connected and reconnect if needed
-// Call this in loop() to maintain connection
+// Service the connection, or take the next step toward it: each call does
+// at most one blocking step (TLS handshake or MQTT CONNECT), and failed
+// attempts back off. The first call starts the first connect. The broker's
+// certificate is checked against the clock, so only call this once NTP has
+// set it. Network task only. Returns true while connected.
 bool maintainAwsIotConnection();
 
-// MQTT callback for incoming messages (currently unused, for future use)
+// MQTT callback for incoming messages
 void mqttCallback(char *topic, byte *payload, unsigned int length);
 
-// Log a message to both Serial and AWS IoT (if connected)
-void log(const char* level, const char* message) {
-  // Always output to Serial
-  Serial.print("[");
-  Serial.print(level);
-  Serial.print("] ");
-  Serial.println(message);
-
-  // If AWS IoT is enabled and connected, publish to MQTT
-  if (Config::isAwsIotEnabled() && mqttClient && mqttClient->connected()) {
-    // Create JSON log message with thing name for easy filtering
-    JsonDocument doc;
-    doc["timestamp"] = time(nullptr);
-    doc["thing_name"] = Config::getAwsIotThingName();
-    doc["level"] = level;
-    doc["message"] = message;
-
-    // Serialize to string
-    String jsonString;
-    serializeJson(doc, jsonString);
-
-    // Publish to log topic (non-blocking)
-    const char* logTopic = Config::getAwsIotLogTopic();
-    mqttClient->publish(logTopic, jsonString.c_str());
+// Largest log topic payload; a flush publishes more than once if needed
+const size_t LOG_BATCH_SIZE = 4096;
+
+// Drain the log ring to Serial and, if connected, to the log topic.
+// Only the network task touches mqttClient, so call it from there.
+void flushLogs();
+
+// Largest metrics report; a report that doesn't fit is logged and kept
+const size_t METRICS_REPORT_SIZE = 2048;
+
+// Publish the metrics recorded since the last report to the metrics topic,
+// the sibling of the log topic (device/{thing}/logs -> device/{thing}/metrics).
+// While disconnected the period keeps running. Network task only.
+void publishMetrics();
+
+// Connection health, registered by setupAwsIot()
+int mqttAttemptsMetric = -1;
+int mqttConnectsMetric = -1;
+int mqttConnectFailuresMetric = -1;
+int mqttDisconnectsMetric = -1;
+int mqttHandshakeMsMetric = -1;
+int mqttConnectMsMetric = -1;
+
+void publishLogBatch(LogBatch &batch) {
+  mqttClient->publish(Config::getAwsIotLogTopic(), batch.payload());
+  batch.clear();
+}
+
+void flushLogs() {
+  static char payload[LOG_BATCH_SIZE];
+  LogBatch batch(payload, sizeof(payload));
+
+  // CloudWatch wants epoch ms; stamp entries relative to now
+  time_t now = time(nullptr);
+  bool publish = Config::isAwsIotEnabled() && mqttClient &&
+                 mqttClient->connected() && now > 1000000000;
+  uint64_t nowEpochMs = (uint64_t)now * 1000;
+  uint32_t nowMs = millis();
+  const char *thingName = publish ? Config::getAwsIotThingName() : nullptr;
+
+  auto flush = [&](const LogEntry &entry) {
+    Serial.printf("[%s] %s\n", logLevelName(entry.level), entry.message);
+    if (!publish) {
+      return;
+    }
+
+    uint64_t epochMs = nowEpochMs - (nowMs - entry.timeMs);
+    if (!batch.add(epochMs, entry.level, thingName, entry.message) &&
+        batch.count() > 0) {
+      // Full: send what we have and start the next publish with this one
+      publishLogBatch(batch);
+      batch.add(epochMs, entry.level, thingName, entry.message);
+    }
+  };
+
+  LogEntry entry;
+  while (logBuffer.read(entry)) {
+    flush(entry);
+  }
+
+  uint32_t dropped = logBuffer.takeDropped();
+  if (dropped > 0) {
+    entry.timeMs = nowMs;
+    entry.level = LOG_LEVEL_WARN;
+    snprintf(entry.message, sizeof(entry.message),
+             "Log buffer full, dropped %u messages", (unsigned)dropped);
+    flush(entry);
+  }
+
+  if (batch.count() > 0) {
+    publishLogBatch(batch);
   }
 }
 
-// Connect to AWS IoT MQTT broker
-// Returns true on success
-bool connectToAwsIot() {
-  if (!Config::isAwsIotEnabled()) {
-    return false;
+void publishMetrics() {
+  if (!Config::isAwsIotEnabled() || !mqttClient || !mqttClient->connected()) {
+    return;
+  }
+
+  static char topic[128];
+  if (!topic[0]) {
+    const char *logTopic = Config::getAwsIotLogTopic();
+    const char *slash = strrchr(logTopic, '/');
+    int prefixLength = slash ? slash - logTopic + 1 : 0;
+    snprintf(topic, sizeof(topic), "%.*smetrics", prefixLength, logTopic);
   }
 
+  char fields[128];
+  snprintf(fields, sizeof(fields), "\"thing_name\":\"%s\",\"uptime_s\":%lu",
+           Config::getAwsIotThingName(), millis() / 1000);
+
+  static char payload[METRICS_REPORT_SIZE];
+  size_t length = metrics.report(payload, sizeof(payload), fields);
+  if (length == 0) {
+    LOG_ERROR("Metrics report exceeds %u bytes", (unsigned)sizeof(payload));
+    return;
+  }
+  mqttClient->publish(topic, (const uint8_t *)payload, length, false);
+}
+
+// Open the TLS connection to the broker (first step of a connect)
+void connectAwsIotTransport() {
+  metrics.increment(mqttAttemptsMetric);
+  unsigned long startMs = millis();
+  bool ok = mqttTransport->connect(Config::getAwsIotEndpoint(),
+                                   AWS_IOT_PORT) == 1;
+  unsigned long handshakeMs = millis() - startMs;
+  if (ok) {
+    metrics.record(mqttHandshakeMsMetric, handshakeMs);
+  } else {
+    LOG_WARN("AWS IoT TLS connect failed after %lums", handshakeMs);
+    metrics.increment(mqttConnectFailuresMetric);
+  }
+  mqttLink->onTransport(ok, millis());
+}
+
+// Send MQTT CONNECT over the open TLS connection and subscribe (second step)
+// Returns true on success
+bool connectToAwsIot() {
   const char *thingName = Config::getAwsIotThingName();
-  Serial.print("Connecting to AWS IoT as ");
-  Serial.println(thingName);
+  LOG_INFO("Connecting to AWS IoT as %s", thingName);
 
   // MQTT client ID must match thing name for policy ${iot:Connection.Thing.ThingName}
-  if (mqttClient->connect(thingName)) {
-    Serial.println("Connected to AWS IoT!");
-    return true;
+  // PubSubClient reuses the transport when it is already connected
+  unsigned long startMs = millis();
+  bool ok = mqttClient->connect(thingName);
+  if (ok) {
+    uint32_t connectMs = millis() - startMs;
+    LOG_INFO("Connected to AWS IoT in %lums", (unsigned long)connectMs);
+    metrics.increment(mqttConnectsMetric);
+    metrics.record(mqttConnectMsMetric, connectMs);
+
+    // Subscriptions don't survive a reconnect (clean session). QoS 1 so the
+    // broker also delivers the retained snapshot for our stop right away.
+    const char *departuresTopic = Config::getAwsIotDeparturesTopic();
+    if (departuresTopic && !mqttClient->subscribe(departuresTopic, 1)) {
+      LOG_ERROR("Failed to subscribe to %s", departuresTopic);
+    }
   } else {
-    Serial.print("AWS IoT connection failed, rc=");
-    Serial.println(mqttClient->state());
-    return false;
+    LOG_WARN("AWS IoT connection failed, rc=%d", mqttClient->state());
+    metrics.increment(mqttConnectFailuresMetric);
+    mqttTransport->stop();
   }
+  mqttLink->onSession(ok, millis());
+  return ok;
 }
 
 bool setupAwsIot() {
@@ -84,39 +210,49 @@ bool setupAwsIot() {
 
   Serial.println("Initializing AWS IoT...");
 
+  mqttAttemptsMetric = metrics.addCounter("mqtt_attempts");
+  mqttConnectsMetric = metrics.addCounter("mqtt_connects");
+  mqttConnectFailuresMetric = metrics.addCounter("mqtt_connect_failures");
+  mqttDisconnectsMetric = metrics.addCounter("mqtt_disconnects");
+  mqttHandshakeMsMetric =
+      metrics.addHistogram("mqtt_handshake_ms", LATENCY_BUCKETS_MS, 8);
+  mqttConnectMsMetric =
+      metrics.addHistogram("mqtt_connect_ms", LATENCY_BUCKETS_MS, 8);
+
   // Create secure WiFi client
   static WiFiClientSecure wifiClient;
+  mqttTransport = &wifiClient;
 
   // Set certificates
   wifiClient.setCACert(Config::getAwsIotRootCa());
   wifiClient.setCertificate(Config::getAwsIotCertPem());
   wifiClient.setPrivateKey(Config::getAwsIotPrivateKey());
+  wifiClient.setHandshakeTimeout(MQTT_HANDSHAKE_TIMEOUT_S);
 
   // Create MQTT client (static so it persists)
   static PubSubClient client(wifiClient);
   mqttClient = &client;
 
+  static Reconnector link(MQTT_BACKOFF, esp_random);
+  mqttLink = &link;
+
   // Configure MQTT broker
   const char *endpoint = Config::getAwsIotEndpoint();
-  mqttClient->setServer(endpoint, 8883);
+  mqttClient->setServer(endpoint, AWS_IOT_PORT);
+  mqttClient->setSocketTimeout(MQTT_CONNACK_TIMEOUT_S);
   mqttClient->setCallback(mqttCallback);
 
   // Increase buffer size for AWS IoT (default 128 is too small)
-  mqttClient->setBufferSize(512);
+  if (!mqttClient->setBufferSize(MQTT_BUFFER_SIZE)) {
+    Serial.println("Failed to allocate MQTT buffer, pushed departures disabled");
+  }
 
   // Set keepalive to 60 seconds (default is 15)
   mqttClient->setKeepAlive(60);
 
   Serial.print("AWS IoT endpoint: ");
   Serial.println(endpoint);
-
-  // Try initial connection
-  if (connectToAwsIot()) {
-    return true;
-  } else {
-    Serial.println("Initial AWS IoT connection failed, will retry...");
-    return false;
-  }
+  return true;
 }
 
 bool maintainAwsIotConnection() {
@@ -124,18 +260,41 @@ bool maintainAwsIotConnection() {
     return false;
   }
 
-  if (!mqttClient->connected()) {
-    log(LOG_WARN, "AWS IoT disconnected, reconnecting");
-    if (!connectToAwsIot()) {
-      return false;
+  switch (mqttLink->next(millis())) {
+  case Reconnector::SERVICE:
+    if (mqttClient->connected()) {
+      mqttClient->loop();
+      return true;
+    }
+    // Count and log the drop once; each failed attempt is counted by
+    // the connect steps
+    LOG_WARN("AWS IoT disconnected, reconnecting");
+    metrics.increment(mqttDisconnectsMetric);
+    mqttLink->onLost();
+    return false;
+  case Reconnector::CONNECT_TRANSPORT:
+    // Without WiFi an attempt can only fail; wait for it instead
+    if (WiFi.status() == WL_CONNECTED) {
+      connectAwsIotTransport();
     }
+    return false;
+  case Reconnector::CONNECT_SESSION:
+    return connectToAwsIot();
+  case Reconnector::WAIT:
+  default:
+    return false;
   }
-
-  mqttClient->loop();
-  return true;
 }
 
 void mqttCallback(char *topic, byte *payload, unsigned int length) {
+  const char *departuresTopic = Config::getAwsIotDeparturesTopic();
+  if (departuresTopic && strcmp(topic, departuresTopic) == 0) {
+    if (departuresHandler) {
+      departuresHandler(payload, length);
+    }
+    return;
+  }
+
   Serial.print("Message received on topic: ");
   Serial.println(topic);
   Serial.print("Payload: ");
@@ -147,5 +306,12 @@ void mqttCallback(char *topic, byte *payload, unsigned int length) {
 
 // Global MQTT client pointer
 PubSubClient *mqttClient = nullptr;
+WiFiClientSecure *mqttTransport = nullptr;
+Reconnector *mqttLink = nullptr;
+DeparturesHandler departuresHandler = nullptr;
+
+void setDeparturesHandler(DeparturesHandler handler) {
+  departuresHandler = handler;
+}
 
 #endif // AWS_IOT_H
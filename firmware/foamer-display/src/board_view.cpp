@@ -0,0 +1,80 @@
+#include "board_view.h"
+
+// Departures are counted down from the fetch, so the minutes shown stay
+// current between fetches and ones that have left are replaced by the next
+static void drawDirection(TextRenderer &text, const Direction &direction,
+                          uint16_t color, uint32_t nowMs) {
+  // Bullet prefix and separator in white, headsign in route color
+  text.print("|", WHITE_COLOR);
+  text.print(direction.headsign, color);
+  text.print(" ", WHITE_COLOR);
+
+  int depCount = 0;
+
+  for (int i = 0; i < direction.departureCount; i++) {
+    if (depCount == MAX_DEPARTURES)
+      break;
+
+    const Departure &dep = direction.departures[i];
+    int minutes = minutesUntil(dep, nowMs);
+    if (minutes < 0)
+      continue; // Already left
+
+    if (depCount > 0) {
+      // Comma always in white
+      text.print(",", WHITE_COLOR);
+    }
+
+    // Color based on departure type
+    text.print(minutes, dep.realtime ? TRANSIT_COLOR : WHITE_COLOR);
+
+    depCount++;
+  }
+  text.newline();
+}
+
+static void drawRoute(TextRenderer &text, const Route &route, uint32_t nowMs) {
+  // Display route name and mode in route color
+  text.print(route.header, route.color);
+  text.newline();
+
+  // Display first two directions (or less if not available)
+  for (int i = 0; i < MAX_DIRECTIONS; i++) {
+    if (i < route.directionCount) {
+      drawDirection(text, route.directions[i], route.color, nowMs);
+    } else {
+      // Write empty line if direction doesn't exist
+      text.newline();
+    }
+  }
+}
+
+void drawRoutePage(TextRenderer &text, const DepartureBoard &board,
+                   int firstRoute, uint32_t nowMs) {
+  text.setCursor(0, 0);
+  for (int i = firstRoute;
+       i < firstRoute + ROUTES_PER_PAGE && i < board.routeCount; i++) {
+    drawRoute(text, board.routes[i], nowMs);
+  }
+}
+
+void drawMessagePage(TextRenderer &text, const DepartureBoard &board,
+                     int page) {
+  int firstLine = page * MESSAGE_LINES_PER_PAGE;
+  text.setCursor(0, 0);
+  for (int i = firstLine; i < firstLine + MESSAGE_LINES_PER_PAGE &&
+                          i < board.messageLineCount;
+       i++) {
+    text.print(board.message[i], MESSAGE_COLOR);
+    text.newline();
+  }
+}
+
+uint32_t messagePageMs(const DepartureBoard &board, int page) {
+  if (board.messageLineCount <= MESSAGE_LINES_PER_PAGE) {
+    // Single page - display all lines for 20s
+    return 20000;
+  }
+  // Two pages - 15s then 5s
+  return page == 0 ? 15000 : 5000;
+}
@@ -0,0 +1,35 @@
+#ifndef BOARD_VIEW_H
+#define BOARD_VIEW_H
+
+#include "departures.h"
+#include "text.h"
+#include <stdint.h>
+
+/* Board colors (RGB565) */
+const uint16_t TRANSIT_COLOR = rgbToColor565(0x3ac364);
+const uint16_t MESSAGE_COLOR = rgbToColor565(0xFF7B9C); // Coral pink between peach and hot pink
+const uint16_t WHITE_COLOR = rgbToColor565(0xFFFFFF);
+
+const int ROUTES_PER_PAGE = 2;
+const int MESSAGE_LINES_PER_PAGE = 6;
+
+// Board pages as text on the character grid. These only draw into a cleared
+// frame; clearing and presenting it is up to the caller, so the same layout
+// runs on the panel and in the native simulator (test/test_sim).
+
+// Up to ROUTES_PER_PAGE routes starting at firstRoute, counted down to nowMs
+void drawRoutePage(TextRenderer &text, const DepartureBoard &board,
+                   int firstRoute, uint32_t nowMs);
+
+// Pages needed for the board's message, 0 without one
+inline int messagePageCount(const DepartureBoard &board) {
+  return (board.messageLineCount + MESSAGE_LINES_PER_PAGE - 1) /
+         MESSAGE_LINES_PER_PAGE;
+}
+
+// One page of the message, and how long it should stay up
+void drawMessagePage(TextRenderer &text, const DepartureBoard &board,
+                     int page);
+uint32_t messagePageMs(const DepartureBoard &board, int page);
+
+#endif // BOARD_VIEW_H
@@ -0,0 +1,51 @@
+#include "boot_timeline.h"
+#include <stdio.h>
+
+const char *bootStageName(BootStage stage) {
+  static const char *const NAMES[BOOT_STAGE_COUNT] = {
+      "display", "restored", "wifi", "fetch", "time", "mqtt", "page",
+  };
+  return stage < BOOT_STAGE_COUNT ? NAMES[stage] : "?";
+}
+
+BootTimeline::BootTimeline(ClockFn clock) : clock(clock) {
+  for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+    stages[i] = 0;
+  }
+}
+
+bool BootTimeline::mark(BootStage stage) {
+  uint32_t unset = 0;
+  return stages[stage].compare_exchange_strong(unset, clock() + 1);
+}
+
+bool BootTimeline::reached(BootStage stage) const {
+  return stages[stage] != 0;
+}
+
+uint32_t BootTimeline::at(BootStage stage) const {
+  uint32_t value = stages[stage];
+  return value ? value - 1 : 0;
+}
+
+size_t BootTimeline::format(char *out, size_t size) const {
+  size_t used = 0;
+  if (size == 0) {
+    return 0;
+  }
+  out[0] = '\0';
+  for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+    BootStage stage = static_cast<BootStage>(i);
+    if (!reached(stage)) {
+      continue;
+    }
+    int n = snprintf(out + used, size - used, "%s%s=%lu", used ? " " : "",
+                     bootStageName(stage), (unsigned long)at(stage));
+    if (n < 0 || used + n >= size) {
+      out[used] = '\0'; // Leave off the stage that didn't fit
+      break;
+    }
+    used += n;
+  }
+  return used;
+}
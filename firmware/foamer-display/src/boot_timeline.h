@@ -0,0 +1,50 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include "scheduler.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Milestones of a boot, in the order they usually happen. After WiFi, the
+// network task works toward the others concurrently, so they can finish in
+// any order.
+enum BootStage : uint8_t {
+  BOOT_DISPLAY,     // Panel and frame buffers up, splash shown
+  BOOT_RESTORED,    // Departures saved before the reboot shown
+  BOOT_WIFI,        // Associated with an address
+  BOOT_FIRST_FETCH, // First departures decoded and published
+  BOOT_TIME,        // NTP set the clock
+  BOOT_MQTT,        // First AWS IoT connect
+  BOOT_FIRST_PAGE,  // First departures page on the panel
+  BOOT_STAGE_COUNT,
+};
+
+// Name used in the timeline log
+const char *bootStageName(BootStage stage);
+
+// When each stage of the boot was first reached, in clock ms. Stages are
+// marked from both tasks; each is recorded once and later marks are ignored.
+class BootTimeline {
+public:
+  explicit BootTimeline(ClockFn clock);
+
+  // Record stage as reached now. Returns false if it already was.
+  bool mark(BootStage stage);
+
+  bool reached(BootStage stage) const;
+
+  // Clock reading when stage was reached, 0 if it hasn't been
+  uint32_t at(BootStage stage) const;
+
+  // "wifi=812 fetch=1630 ..." for the stages reached so far, in stage order.
+  // Returns the length written.
+  size_t format(char *out, size_t size) const;
+
+private:
+  ClockFn clock;
+  // Clock reading + 1, so a stage reached at 0 still reads as reached
+  std::atomic<uint32_t> stages[BOOT_STAGE_COUNT];
+};
+
+#endif // BOOT_TIMELINE_H
@@ -1,42 +1,122 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#include <ArduinoJson.h>
+#include <stdint.h>
 
-// Config class for accessing embedded configuration
+// Settings from the config profile (and the device's AWS IoT files), filled
+// in at build time. scripts/embed_config.py checks the profile and writes
+// CONFIG_DATA in this field order to config_data.h; a missing required field
+// fails the build there.
+struct ConfigData {
+  // WiFi
+  const char *wifiSsid;
+  const char *wifiPassword;
+  bool wifiReuseLease; // Only where the router reserves the device's address
+
+  // API
+  const char *apiUrl;
+  const char *apiSecret;
+
+  // Geo
+  const char *geoLat;
+  const char *geoLon;
+
+  // Display
+  int pageIntervalMs;
+  int messageIntervalMs;
+  const char *displayProfile; // DMA driver profile name, see display_profile.h
+
+  // Polling (optional section, defaults filled in by the script)
+  uint32_t pollMinMs;
+  uint32_t pollMaxMs;
+  uint32_t pollRealtimeMs;
+  uint32_t pollRetryMs;
+  uint32_t pollBackoffMaxMs;
+
+  // AWS IoT (strings are nullptr when disabled)
+  bool awsIotEnabled;
+  const char *awsIotEndpoint;
+  const char *awsIotThingName;
+  const char *awsIotLogTopic;
+  const char *awsIotDeparturesTopic;
+  uint32_t metricsIntervalMs;
+  const char *awsIotCertPem; // PEM blobs stay in flash
+  const char *awsIotPrivateKey;
+  const char *awsIotRootCa;
+};
+
+#include "config_data.h" // Generated by build script
+
+// Config class for accessing embedded configuration.
+// Every getter is a constant; nothing is parsed or allocated at runtime.
 class Config {
 public:
-  // Initialize and parse the embedded config JSON
-  static bool begin();
-
   // WiFi settings
-  static const char *getWifiSSID();
-  static const char *getWifiPassword();
+  static constexpr const char *getWifiSSID() { return CONFIG_DATA.wifiSsid; }
+  static constexpr const char *getWifiPassword() {
+    return CONFIG_DATA.wifiPassword;
+  }
+  static constexpr bool getWifiReuseLease() {
+    return CONFIG_DATA.wifiReuseLease;
+  }
 
   // API settings
-  static const char *getApiUrl();
-  static const char *getApiSecret();
+  static constexpr const char *getApiUrl() { return CONFIG_DATA.apiUrl; }
+  static constexpr const char *getApiSecret() { return CONFIG_DATA.apiSecret; }
 
   // Geo settings
-  static const char *getGeoLat();
-  static const char *getGeoLon();
+  static constexpr const char *getGeoLat() { return CONFIG_DATA.geoLat; }
+  static constexpr const char *getGeoLon() { return CONFIG_DATA.geoLon; }
 
   // Display settings
-  static int getPageIntervalMs();
-  static int getMessageIntervalMs();
+  static constexpr int getPageIntervalMs() {
+    return CONFIG_DATA.pageIntervalMs;
+  }
+  static constexpr int getMessageIntervalMs() {
+    return CONFIG_DATA.messageIntervalMs;
+  }
+  static constexpr const char *getDisplayProfile() {
+    return CONFIG_DATA.displayProfile;
+  }
+
+  // Polling settings
+  static constexpr uint32_t getPollMinMs() { return CONFIG_DATA.pollMinMs; }
+  static constexpr uint32_t getPollMaxMs() { return CONFIG_DATA.pollMaxMs; }
+  static constexpr uint32_t getPollRealtimeMs() {
+    return CONFIG_DATA.pollRealtimeMs;
+  }
+  static constexpr uint32_t getPollRetryMs() { return CONFIG_DATA.pollRetryMs; }
+  static constexpr uint32_t getPollBackoffMaxMs() {
+    return CONFIG_DATA.pollBackoffMaxMs;
+  }
 
   // AWS IoT settings
-  static bool isAwsIotEnabled();
-  static const char *getAwsIotEndpoint();
-  static const char *getAwsIotThingName();
-  static const char *getAwsIotLogTopic();
-  static const char *getAwsIotCertPem();
-  static const char *getAwsIotPrivateKey();
-  static const char *getAwsIotRootCa();
-
-private:
-  static JsonDocument doc;
-  static bool initialized;
+  static constexpr bool isAwsIotEnabled() { return CONFIG_DATA.awsIotEnabled; }
+  static constexpr const char *getAwsIotEndpoint() {
+    return CONFIG_DATA.awsIotEndpoint;
+  }
+  static constexpr const char *getAwsIotThingName() {
+    return CONFIG_DATA.awsIotThingName;
+  }
+  static constexpr const char *getAwsIotLogTopic() {
+    return CONFIG_DATA.awsIotLogTopic;
+  }
+  // nullptr if not provisioned
+  static constexpr const char *getAwsIotDeparturesTopic() {
+    return CONFIG_DATA.awsIotDeparturesTopic;
+  }
+  static constexpr uint32_t getMetricsIntervalMs() {
+    return CONFIG_DATA.metricsIntervalMs;
+  }
+  static constexpr const char *getAwsIotCertPem() {
+    return CONFIG_DATA.awsIotCertPem;
+  }
+  static constexpr const char *getAwsIotPrivateKey() {
+    return CONFIG_DATA.awsIotPrivateKey;
+  }
+  static constexpr const char *getAwsIotRootCa() {
+    return CONFIG_DATA.awsIotRootCa;
+  }
 };
 
 #endif // CONFIG_H
@@ -0,0 +1,132 @@
+#include "departures.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+const JsonDocument &departuresFilter() {
+  // Built on first use and kept for the lifetime of the program
+  static JsonDocument filter;
+
+  if (filter.isNull()) {
+    // In a filter, the first element of an array applies to every element
+    filter["routes"][0]["name"] = true;
+    filter["routes"][0]["mode"] = true;
+    filter["routes"][0]["color"] = true;
+
+    JsonObject direction = filter["routes"][0]["directions"][0].to<JsonObject>();
+    direction["headsign"] = true;
+    direction["departures"][0]["type"] = true;
+    direction["departures"][0]["minutes"] = true;
+    direction["departures"][0]["at"] = true;
+
+    filter["message"] = true;
+  }
+
+  return filter;
+}
+
+bool isRealTime(JsonVariantConst type) {
+  if (type.is<int>()) {
+    return type.as<int>() == 1;
+  }
+  const char *name = type;
+  return name && strcmp(name, "RealTime") == 0;
+}
+
+uint32_t routeColorRgb(JsonVariantConst color) {
+  if (color.is<const char *>()) {
+    return strtol(color.as<const char *>(), NULL, 16);
+  }
+  return color.as<uint32_t>();
+}
+
+// Copy src upper-cased into dest, cut to width chars, optionally padding with
+// spaces up to width. dest must hold width + 1 chars.
+static void copyUpper(char *dest, const char *src, int width, bool pad) {
+  int i = 0;
+  for (; src && src[i] && i < width; i++) {
+    dest[i] = toupper(static_cast<unsigned char>(src[i]));
+  }
+  for (; pad && i < width; i++) {
+    dest[i] = ' ';
+  }
+  dest[i] = '\0';
+}
+
+// Anything before 2001 means the clock was never set
+static const uint32_t MIN_VALID_EPOCH = 1000000000;
+
+// millis() deadline for a departure
+static uint32_t departureDueMs(JsonObject dep, uint32_t nowMs,
+                               uint32_t nowEpoch) {
+  uint32_t at = dep["at"].as<uint32_t>();
+  if (at > 0 && nowEpoch >= MIN_VALID_EPOCH) {
+    return nowMs + static_cast<int32_t>(at - nowEpoch) * 1000;
+  }
+
+  // Older servers only send whole minutes, rounded down. Assume the middle of
+  // that minute so the error is at most half a minute either way.
+  int minutes = dep["minutes"];
+  return nowMs + minutes * 60000 + 30000;
+}
+
+bool decodeDepartures(JsonDocument &doc, DepartureBoard &board,
+                      uint32_t nowMs, uint32_t nowEpoch) {
+  JsonArray routes = doc["routes"];
+  if (routes.isNull()) {
+    return false;
+  }
+
+  board.fetchedEpoch = nowEpoch >= MIN_VALID_EPOCH ? nowEpoch : 0;
+
+  board.routeCount = 0;
+  for (JsonObject routeJson : routes) {
+    if (board.routeCount == MAX_ROUTES) {
+      break;
+    }
+    Route &route = board.routes[board.routeCount++];
+
+    // Header is the upper-cased name followed by the mode as sent
+    copyUpper(route.header, routeJson["name"], LINE_CHARS, false);
+    int len = strlen(route.header);
+    if (len < LINE_CHARS) {
+      const char *mode = routeJson["mode"] | "";
+      snprintf(route.header + len, sizeof(route.header) - len, " %s", mode);
+    }
+    route.color = rgbToColor565(routeColorRgb(routeJson["color"]));
+
+    route.directionCount = 0;
+    for (JsonObject directionJson : routeJson["directions"].as<JsonArray>()) {
+      if (route.directionCount == MAX_DIRECTIONS) {
+        break;
+      }
+      Direction &direction = route.directions[route.directionCount++];
+      copyUpper(direction.headsign, directionJson["headsign"], HEADSIGN_WIDTH,
+                true);
+
+      direction.departureCount = 0;
+      for (JsonObject dep : directionJson["departures"].as<JsonArray>()) {
+        if (direction.departureCount == MAX_STORED_DEPARTURES) {
+          break;
+        }
+        Departure &departure =
+            direction.departures[direction.departureCount++];
+        departure.dueMs = departureDueMs(dep, nowMs, nowEpoch);
+        departure.realtime = isRealTime(dep["type"]);
+      }
+    }
+  }
+
+  board.messageLineCount = 0;
+  for (JsonVariant line : doc["message"].as<JsonArray>()) {
+    if (board.messageLineCount == MAX_MESSAGE_LINES) {
+      break;
+    }
+    const char *text = line | "";
+    snprintf(board.message[board.messageLineCount++], LINE_CHARS + 1, "%s",
+             text);
+  }
+
+  return true;
+}
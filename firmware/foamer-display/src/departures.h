@@ -0,0 +1,105 @@
+#ifndef DEPARTURES_H
+#define DEPARTURES_H
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+
+/* Board layout limits */
+const int LINE_CHARS = 16;    // 96px wide panel / 6px per glyph
+const int HEADSIGN_WIDTH = 6; // Headsign column, padded or truncated
+const int MAX_ROUTES = 16;
+const int MAX_DIRECTIONS = 2; // Directions shown per route
+const int MAX_DEPARTURES = 3; // Departures shown per direction
+const int MAX_STORED_DEPARTURES = 6; // Kept to replace ones that have left
+const int MAX_MESSAGE_LINES = 12;
+
+/* Decoded departures, ready to render without touching JSON */
+struct Departure {
+  uint32_t dueMs; // millis() at which it leaves, counted down locally
+  bool realtime;
+};
+
+struct Direction {
+  char headsign[HEADSIGN_WIDTH + 1]; // Upper-cased, space padded
+  uint8_t departureCount;
+  Departure departures[MAX_STORED_DEPARTURES];
+};
+
+struct Route {
+  char header[LINE_CHARS + 1]; // "NAME mode", cut to one line
+  uint16_t color;              // RGB565
+  uint8_t directionCount;
+  Direction directions[MAX_DIRECTIONS];
+};
+
+struct DepartureBoard {
+  uint32_t fetchedEpoch; // Unix time of the fetch, 0 if the clock wasn't set
+  uint8_t routeCount;
+  Route routes[MAX_ROUTES];
+  uint8_t messageLineCount; // 0 when there is no message
+  char message[MAX_MESSAGE_LINES][LINE_CHARS + 1];
+};
+
+// Convert packed 0xRRGGBB color to RGB565
+constexpr uint16_t rgbToColor565(uint32_t rgb) {
+  return ((rgb >> 8) & 0xF800) | ((rgb >> 5) & 0x07E0) | ((rgb >> 3) & 0x001F);
+}
+
+// Filter document describing the fields of a /departures response that the
+// board actually renders. Everything else is skipped during parsing.
+const JsonDocument &departuresFilter();
+
+// Deserialize a /departures response through departuresFilter().
+// input can be a Stream (e.g. the WiFiClient behind HTTPClient::getStream()),
+// in which case the body is parsed as bytes arrive and never buffered whole.
+// It can also be a char buffer or std::string for the buffered path and tests.
+template <typename TInput>
+DeserializationError parseDepartures(TInput &&input, JsonDocument &doc) {
+  return deserializeJson(doc, input,
+                         DeserializationOption::Filter(departuresFilter()));
+}
+
+// Same for a buffer of known length, such as an MQTT payload
+template <typename TChar>
+DeserializationError parseDepartures(const TChar *input, size_t length,
+                                     JsonDocument &doc) {
+  return deserializeJson(doc, input, length,
+                         DeserializationOption::Filter(departuresFilter()));
+}
+
+// Same as parseDepartures() for the compact MessagePack encoding, which the
+// server sends for "Accept: application/msgpack"
+template <typename TInput>
+DeserializationError parseDeparturesMsgPack(TInput &&input, JsonDocument &doc) {
+  return deserializeMsgPack(doc, input,
+                            DeserializationOption::Filter(departuresFilter()));
+}
+
+template <typename TChar>
+DeserializationError parseDeparturesMsgPack(const TChar *input, size_t length,
+                                            JsonDocument &doc) {
+  return deserializeMsgPack(doc, input, length,
+                            DeserializationOption::Filter(departuresFilter()));
+}
+
+// The JSON encoding carries departure types as "RealTime"/"Scheduled" and
+// colors as hex strings; the compact encoding as 1/0 and packed 0xRRGGBB.
+// These accept either.
+bool isRealTime(JsonVariantConst type);
+uint32_t routeColorRgb(JsonVariantConst color);
+
+// Decode a parsed /departures document into board, doing all string and
+// color work once per fetch. Lists longer than the board can hold are cut.
+// nowMs is millis() and nowEpoch the unix time (0 if unknown) at decode;
+// departure times are anchored to them so they can be counted down locally.
+// Returns false if doc has no routes array.
+bool decodeDepartures(JsonDocument &doc, DepartureBoard &board,
+                      uint32_t nowMs, uint32_t nowEpoch);
+
+// Whole minutes until dep leaves at nowMs, or -1 once it has left
+inline int minutesUntil(const Departure &dep, uint32_t nowMs) {
+  int32_t remainingMs = static_cast<int32_t>(dep.dueMs - nowMs);
+  return remainingMs < 0 ? -1 : remainingMs / 60000;
+}
+
+#endif // DEPARTURES_H
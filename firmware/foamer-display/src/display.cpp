@@ -1,6 +1,9 @@
 #include "display.h"
 
 // Function to create and initialize the display object
-MatrixPanel_I2S_DMA* createDisplay() {
-  return new MatrixPanel_I2S_DMA(initConfig());
+MatrixPanel_I2S_DMA* createDisplay(const DisplayProfile &profile) {
+  MatrixPanel_I2S_DMA *display = new MatrixPanel_I2S_DMA(initConfig(profile));
+  // Sizes the DMA buffers, so it has to come before begin()
+  display->setPixelColorDepthBits(profile.colorDepthBits);
+  return display;
 }
@@ -1,6 +1,7 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
+#include "display_profile.h"
 #include <ESP32-HUB75-MatrixPanel-I2S-DMA.h>
 
 /* MatrixPortal-S3 ↔ HUB75 pin map */
@@ -15,19 +16,26 @@ const HUB75_I2S_CFG::i2s_pins PINMAP = {
 };
 
 /* Panel configuration --------------------------------------------------- */
+const int PANEL_WIDTH = 96;
+const int PANEL_HEIGHT = 48;
+
 // HUB75_I2S_CFG is a CLASS (like a struct with functions)
 // This creates an OBJECT/INSTANCE of that class by calling its CONSTRUCTOR
 // Constructor syntax: ClassName varName(arg1, arg2, ...)
 // Similar to: HUB75_I2S_CFG mxcfg; mxcfg_init(&mxcfg, 96, 48, 1, PINMAP); in C
 
-// Helper function to initialize mxcfg with clkphase before display construction
-inline HUB75_I2S_CFG initConfig() {
-  HUB75_I2S_CFG cfg(96, 48, 1, PINMAP);
+// Helper function to initialize mxcfg with clkphase and the profile's timing
+// before display construction
+inline HUB75_I2S_CFG initConfig(const DisplayProfile &profile) {
+  HUB75_I2S_CFG cfg(PANEL_WIDTH, PANEL_HEIGHT, 1, PINMAP);
   cfg.clkphase = false; // sample on falling edge to fix ghosting
+  cfg.i2sspeed = static_cast<HUB75_I2S_CFG::clk_speed>(profile.i2sSpeedHz);
+  cfg.min_refresh_rate = profile.minRefreshHz;
+  cfg.latch_blanking = profile.latchBlanking;
   return cfg;
 }
 
-// Function to create and initialize the display object
-MatrixPanel_I2S_DMA* createDisplay();
+// Function to create the display object for profile; call begin() on it
+MatrixPanel_I2S_DMA* createDisplay(const DisplayProfile &profile);
 
 #endif
@@ -0,0 +1,49 @@
+#include "display_profile.h"
+#include <string.h>
+
+// Keep the names in step with DISPLAY_PROFILES in scripts/embed_config.py
+static const DisplayProfile PROFILES[] = {
+    {"full", 8, 60, 8000000, 1},
+    {"balanced", 5, 90, 8000000, 1},
+    {"flat", 3, 120, 10000000, 2},
+};
+
+const DisplayProfile *findDisplayProfile(const char *name) {
+  for (const DisplayProfile &profile : PROFILES) {
+    if (name && strcmp(profile.name, name) == 0) {
+      return &profile;
+    }
+  }
+  return nullptr;
+}
+
+const DisplayProfile &defaultDisplayProfile() { return PROFILES[0]; }
+
+// Row shifts per row of the panel: plane i is shown 2^(i - transition)
+// times above the transition bit, once at or below it
+static uint32_t shiftsPerRow(int bits, int transition) {
+  uint32_t shifts = 0;
+  for (int i = 0; i < bits; i++) {
+    shifts += i > transition ? 1u << (i - transition) : 1;
+  }
+  return shifts;
+}
+
+uint32_t estimateRefreshHz(const DisplayProfile &profile, int width,
+                           int height) {
+  int bits = profile.colorDepthBits;
+  uint64_t rowsPerFrame = height / 2;
+  uint64_t clocksPerShift = width;
+
+  // Lowest transition bit that reaches the minimum, like the driver
+  uint32_t refreshHz = 0;
+  for (int transition = 0; transition < bits; transition++) {
+    uint64_t clocksPerFrame =
+        clocksPerShift * shiftsPerRow(bits, transition) * rowsPerFrame;
+    refreshHz = profile.i2sSpeedHz / clocksPerFrame;
+    if (refreshHz >= profile.minRefreshHz) {
+      break;
+    }
+  }
+  return refreshHz;
+}
@@ -0,0 +1,32 @@
+#ifndef DISPLAY_PROFILE_H
+#define DISPLAY_PROFILE_H
+
+#include <stdint.h>
+
+// HUB75 DMA driver settings, picked by name with display.profile in the
+// config. The board only shows a handful of flat colors, so fewer color
+// depth bits cost little on screen and save internal SRAM and DMA bandwidth.
+struct DisplayProfile {
+  const char *name;
+  uint8_t colorDepthBits; // Bit planes per color channel, 1..8
+  uint16_t minRefreshHz;  // The driver trades color timing to reach this
+  uint32_t i2sSpeedHz;    // Pixel clock: 8, 10, 15 or 20 MHz
+  uint8_t latchBlanking;  // Clocks of OE blanking around each latch
+};
+
+// "full" is the driver's defaults; "balanced" and "flat" give up color depth
+// for memory and refresh rate. nullptr if name isn't one of them.
+const DisplayProfile *findDisplayProfile(const char *name);
+
+// The profile the device runs when the configured one is unknown
+const DisplayProfile &defaultDisplayProfile();
+
+// Scan rate of the whole panel (top to bottom) the driver ends up with, in
+// Hz, from its binary code modulation timing: each bit plane is shifted out
+// once per row, and to reach minRefreshHz the driver shows more of the low
+// planes only once instead of for their full binary weight. height is the
+// panel height; two rows are driven at a time.
+uint32_t estimateRefreshHz(const DisplayProfile &profile, int width,
+                           int height);
+
+#endif // DISPLAY_PROFILE_H
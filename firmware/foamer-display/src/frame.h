@@ -0,0 +1,42 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+
+// Write the pixels of next that differ from shown to panel and update shown
+// to match. Each run of changed pixels sharing one color goes out as a
+// single line, which the DMA driver writes faster than single pixels.
+// Panel is anything with drawFastHLine(x, y, w, color): MatrixPanel_I2S_DMA
+// on the device, the simulator's fake panel on the host.
+// Returns the number of pixels written.
+template <typename Panel>
+uint32_t presentChanges(const uint16_t *next, uint16_t *shown, int width,
+                        int height, Panel &panel) {
+  uint32_t written = 0;
+
+  for (int y = 0; y < height; y++) {
+    const uint16_t *row = next + y * width;
+    uint16_t *old = shown + y * width;
+
+    int x = 0;
+    while (x < width) {
+      if (row[x] == old[x]) {
+        x++;
+        continue;
+      }
+
+      int start = x;
+      uint16_t color = row[x];
+      while (x < width && row[x] != old[x] && row[x] == color) {
+        old[x] = color;
+        x++;
+      }
+      panel.drawFastHLine(start, y, x - start, color);
+      written += x - start;
+    }
+  }
+
+  return written;
+}
+
+#endif // FRAME_H
@@ -0,0 +1,45 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free handoff of snapshots from one writer task to one reader task.
+// Three buffers rotate through back (being written), middle (latest
+// published) and front (being read), so neither side ever waits for the
+// other and the reader never sees a half-written snapshot.
+template <typename T> class TripleBuffer {
+public:
+  // Writer: fill back(), then publish() it
+  T &back() { return buffers[backIndex]; }
+
+  void publish() {
+    uint32_t previous =
+        middle.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+    backIndex = previous & INDEX_MASK;
+  }
+
+  // Reader: swap in the latest published buffer, if there is a newer one.
+  // front() stays stable until the next update() call.
+  bool update() {
+    if (!(middle.load(std::memory_order_acquire) & FRESH)) {
+      return false;
+    }
+    uint32_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+    frontIndex = previous & INDEX_MASK;
+    return true;
+  }
+
+  const T &front() const { return buffers[frontIndex]; }
+
+private:
+  static const uint32_t INDEX_MASK = 0x3;
+  static const uint32_t FRESH = 0x4; // middle holds an unread publish
+
+  T buffers[3] = {};
+  uint32_t backIndex = 0;
+  std::atomic<uint32_t> middle{1};
+  uint32_t frontIndex = 2;
+};
+
+#endif // HANDOFF_H
@@ -0,0 +1,180 @@
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+
+LogBuffer logBuffer;
+static LogClockFn logClock = nullptr;
+
+const char *logLevelName(uint8_t level) {
+  switch (level) {
+  case LOG_LEVEL_DEBUG:
+    return "DEBUG";
+  case LOG_LEVEL_INFO:
+    return "INFO";
+  case LOG_LEVEL_WARN:
+    return "WARNING";
+  default:
+    return "ERROR";
+  }
+}
+
+LogBuffer::LogBuffer() : first(0), count(0), dropped(0), droppedReported(0) {
+#ifdef ARDUINO
+  portMUX_INITIALIZE(&mutex);
+#endif
+}
+
+// A critical section on the device: writers on either core only hold it for
+// one memcpy, and it can't be preempted while held
+void LogBuffer::lock() {
+#ifdef ARDUINO
+  portENTER_CRITICAL(&mutex);
+#else
+  mutex.lock();
+#endif
+}
+
+void LogBuffer::unlock() {
+#ifdef ARDUINO
+  portEXIT_CRITICAL(&mutex);
+#else
+  mutex.unlock();
+#endif
+}
+
+bool LogBuffer::write(uint8_t level, uint32_t timeMs, const char *format,
+                      va_list args) {
+  // Format outside the lock, on the caller's stack
+  char message[LOG_MESSAGE_SIZE];
+  vsnprintf(message, sizeof(message), format, args);
+
+  lock();
+  bool stored = count < LOG_CAPACITY;
+  if (stored) {
+    LogEntry &entry = entries[(first + count) % LOG_CAPACITY];
+    entry.timeMs = timeMs;
+    entry.level = level;
+    memcpy(entry.message, message, sizeof(message));
+    count++;
+  } else {
+    dropped++;
+  }
+  unlock();
+
+  return stored;
+}
+
+bool LogBuffer::read(LogEntry &entry) {
+  lock();
+  bool found = count > 0;
+  if (found) {
+    memcpy(&entry, &entries[first], sizeof(LogEntry));
+    first = (first + 1) % LOG_CAPACITY;
+    count--;
+  }
+  unlock();
+
+  return found;
+}
+
+uint32_t LogBuffer::takeDropped() {
+  lock();
+  uint32_t since = dropped - droppedReported;
+  droppedReported = dropped;
+  unlock();
+
+  return since;
+}
+
+// Append text to buffer without going past size
+static bool append(char *buffer, size_t size, size_t &used, const char *text) {
+  size_t length = strlen(text);
+  if (used + length > size) {
+    return false;
+  }
+  memcpy(buffer + used, text, length);
+  used += length;
+  return true;
+}
+
+// Same, escaped for the inside of a JSON string
+static bool appendEscaped(char *buffer, size_t size, size_t &used,
+                          const char *text) {
+  for (; *text; text++) {
+    unsigned char c = *text;
+    char escaped[7];
+    if (c == '"' || c == '\\') {
+      escaped[0] = '\\';
+      escaped[1] = c;
+      escaped[2] = '\0';
+    } else if (c < 0x20) {
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+    } else {
+      escaped[0] = c;
+      escaped[1] = '\0';
+    }
+    if (!append(buffer, size, used, escaped)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+LogBatch::LogBatch(char *buffer, size_t size) : buffer(buffer), size(size) {
+  clear();
+}
+
+void LogBatch::clear() {
+  buffer[0] = '[';
+  used = 1;
+  entries = 0;
+}
+
+bool LogBatch::add(uint64_t epochMs, uint8_t level, const char *thingName,
+                   const char *message) {
+  // The message object on its own first...
+  char object[2 * LOG_MESSAGE_SIZE + 160];
+  size_t objectUsed = 0;
+  size_t objectLimit = sizeof(object) - 1;
+  if (!append(object, objectLimit, objectUsed, "{\"thing_name\":\"") ||
+      !appendEscaped(object, objectLimit, objectUsed, thingName) ||
+      !append(object, objectLimit, objectUsed, "\",\"level\":\"") ||
+      !append(object, objectLimit, objectUsed, logLevelName(level)) ||
+      !append(object, objectLimit, objectUsed, "\",\"message\":\"") ||
+      !appendEscaped(object, objectLimit, objectUsed, message) ||
+      !append(object, objectLimit, objectUsed, "\"}")) {
+    return false;
+  }
+  object[objectUsed] = '\0';
+
+  // ...then as a string in the batch record, keeping room for "]\0"
+  char record[48];
+  snprintf(record, sizeof(record), "%s{\"timestamp\":%llu,\"message\":\"",
+           entries > 0 ? "," : "", (unsigned long long)epochMs);
+  size_t start = used;
+  size_t limit = size - 2;
+  if (!append(buffer, limit, used, record) ||
+      !appendEscaped(buffer, limit, used, object) ||
+      !append(buffer, limit, used, "\"}")) {
+    used = start;
+    return false;
+  }
+
+  entries++;
+  return true;
+}
+
+const char *LogBatch::payload() {
+  buffer[used] = ']';
+  buffer[used + 1] = '\0';
+  return buffer;
+}
+
+void logBegin(LogClockFn clock) { logClock = clock; }
+
+void logWrite(uint8_t level, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  logBuffer.write(level, logClock ? logClock() : 0, format, args);
+  va_end(args);
+}
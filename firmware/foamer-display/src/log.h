@@ -0,0 +1,123 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <freertos/FreeRTOS.h>
+typedef portMUX_TYPE LogLock;
+#else
+#include <mutex>
+typedef std::mutex LogLock;
+#endif
+
+enum LogLevel : uint8_t {
+  LOG_LEVEL_DEBUG,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_ERROR,
+};
+
+// Messages below this level compile out, arguments included.
+// Override with e.g. -DLOG_LEVEL=LOG_LEVEL_DEBUG in build_flags.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// printf-style logging from any task. Formats into the log ring and returns;
+// flushLogs() does the Serial and MQTT output later from the network task.
+#define LOG_AT(level, ...)                                                     \
+  do {                                                                         \
+    if ((level) >= LOG_LEVEL)                                                  \
+      logWrite((level), __VA_ARGS__);                                          \
+  } while (0)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+const size_t LOG_MESSAGE_SIZE = 120; // Longer messages are truncated
+const size_t LOG_CAPACITY = 32;      // Entries held between flushes
+
+// Level name as it appears in Serial output and CloudWatch
+const char *logLevelName(uint8_t level);
+
+struct LogEntry {
+  uint32_t timeMs; // Clock reading when logged
+  uint8_t level;
+  char message[LOG_MESSAGE_SIZE];
+};
+
+// Fixed-size ring of formatted messages, safe to write from several tasks.
+// When full, new messages are dropped and counted rather than blocking.
+class LogBuffer {
+public:
+  LogBuffer();
+
+  // Format a message into the ring. Returns false if it was dropped.
+  bool write(uint8_t level, uint32_t timeMs, const char *format,
+             va_list args);
+
+  // Take the oldest message. Returns false if the ring is empty.
+  bool read(LogEntry &entry);
+
+  // Messages dropped since the last call
+  uint32_t takeDropped();
+
+  // Messages dropped since boot
+  uint32_t totalDropped() const { return dropped; }
+
+private:
+  void lock();
+  void unlock();
+
+  LogEntry entries[LOG_CAPACITY];
+  size_t first; // Oldest entry
+  size_t count;
+  uint32_t dropped;
+  uint32_t droppedReported;
+  LogLock mutex;
+};
+
+// Builds one MQTT payload for the CloudWatch Logs rule action in batch mode:
+// a JSON array of {"timestamp": <epoch ms>, "message": "<json>"}, where each
+// message is the JSON object a single log line used to be published as.
+class LogBatch {
+public:
+  LogBatch(char *buffer, size_t size);
+
+  void clear();
+
+  // Append a message. Returns false, leaving the batch as it was, if it
+  // doesn't fit.
+  bool add(uint64_t epochMs, uint8_t level, const char *thingName,
+           const char *message);
+
+  size_t count() const { return entries; }
+
+  // The finished payload (valid until the next add() or clear())
+  const char *payload();
+  size_t length() const { return used + 1; }
+
+private:
+  char *buffer;
+  size_t size;
+  size_t used; // Bytes before the closing ']'
+  size_t entries;
+};
+
+typedef uint32_t (*LogClockFn)();
+
+// The ring logWrite() formats into
+extern LogBuffer logBuffer;
+
+// Set the clock stamped on messages (millis() on the device)
+void logBegin(LogClockFn clock);
+
+// Use the LOG_* macros instead, so filtered levels compile out
+void logWrite(uint8_t level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#endif // LOG_H
@@ -1,229 +1,696 @@
 // Include directives - <> means search in library/system paths
+#include "alloc_counter.h"
+#include "api_connection.h"
+#include "arena.h"
+#include "assets.h"
+#include "board_view.h"
+#include "boot_timeline.h"
 #include "config.h"
+#include "departures.h"
 #include "display.h"
+#include "display_profile.h"
+#include "handoff.h"
+#include "log.h"
+#include "metrics.h"
 #include "network.h"
-#include "splash.h"
+#include "polling.h"
+#include "renderer.h"
+#include "scheduler.h"
+#include "snapshot_store.h"
 #include "aws_iot.h"
 #include <Adafruit_GFX.h> // Adafruit graphics library (class-based)
 #include <ArduinoJson.h>  // JSON parsing library
+#include <Preferences.h>  // NVS storage of the last departures
+#include <esp_heap_caps.h> // DMA-capable memory used by the display
 #include <time.h>         // For NTP time sync
 
-/* Display configuration constants */
-const char *ERROR_COLOR = "D70000";
-const int HEADSIGN_WIDTH = 6;
-const char *TRANSIT_COLOR = "3ac364";
-const char *MESSAGE_COLOR = "FF7B9C"; // Coral pink between peach and hot pink
+/* Display configuration constants (RGB565) */
+const uint16_t ERROR_COLOR = rgbToColor565(0xD70000);
 
-// Global variables for rotation
+// PSRAM arena for the JSON document of one fetch or push. The largest push
+// MQTT accepts is 16 KB; its document fits with room to spare.
+const size_t JSON_ARENA_SIZE = 64 * 1024;
+
+// How often buffered log messages go out to Serial and MQTT
+const uint32_t LOG_FLUSH_MS = 2000;
+
+// Wait between WiFi connects that failed
+const uint32_t WIFI_RETRY_MS = 5000;
+
+// How often the clock is checked while NTP hasn't set it, and how long
+// after WiFi that is reported as a failure
+const uint32_t TIME_CHECK_MS = 100;
+const uint32_t NTP_TIMEOUT_MS = 10000;
+
+// Anything before 2001 means the clock was never set
+const time_t MIN_VALID_TIME = 1000000000;
+
+// The last departures are saved to NVS at most this often, to spare the
+// flash; a snapshot older than MAX_RESTORE_AGE_S isn't shown after a reboot
+// (once the clock tells, which after a power cycle is only when NTP is done)
+const uint32_t SNAPSHOT_SAVE_INTERVAL_MS = 15 * 60 * 1000;
+const uint32_t MAX_RESTORE_AGE_S = 2 * 60 * 60;
+
+// Outcome of a departures fetch
+enum FetchResult {
+  FETCH_OK,           // board holds fresh data
+  FETCH_NOT_MODIFIED, // server answered 304, board left untouched
+  FETCH_FAILED,
+};
+
+// Decoded departures handed from the network task to the render task
+struct BoardSnapshot {
+  uint32_t publishedMs; // millis() when the network task published it
+  bool restored;        // Saved before the last reboot, not fetched since
+  DepartureBoard board;
+};
+
+// Global variables for rotation (render task)
 int currentRouteIndex = 0;
-int totalRoutes = 0;
 unsigned long lastMessageTimeMs = 0; // Track when last message was displayed
-JsonDocument globalDoc;              // Global to store fetched data
 MatrixPanel_I2S_DMA *display;        // Pointer to display object
-
-// Convert hex color string (e.g., "2da646") to RGB565 color
-uint16_t hexToColor565(const char *hex) {
-  // Parse hex string to RGB components
-  long hexValue = strtol(hex, NULL, 16);
-  uint8_t r = (hexValue >> 16) & 0xFF;
-  uint8_t g = (hexValue >> 8) & 0xFF;
-  uint8_t b = hexValue & 0xFF;
-  return display->color565(r, g, b);
+Renderer *canvas;                    // Off-screen frame presented to display
+
+// Global variables for fetching (network task)
+ApiConnection apiConnection;         // Kept open across fetches
+PollingPolicy *pollingPolicy;        // Decides when to fetch next
+char departuresPath[96];             // Request path, formatted in setup()
+char departuresEtag[80];             // Validators of the last published board
+char departuresLastModified[40];
+ArenaAllocator jsonArena;            // Holds each parsed document, reset per parse
+
+TripleBuffer<BoardSnapshot> snapshots; // Network task -> render task
+
+// Boot milestones, marked from both tasks
+BootTimeline bootTimeline([]() -> uint32_t { return millis(); });
+
+// Record a boot milestone the first time it is reached
+void markBoot(BootStage stage) {
+  if (bootTimeline.mark(stage)) {
+    LOG_INFO("Boot: %s at %lums", bootStageName(stage),
+             (unsigned long)bootTimeline.at(stage));
+  }
 }
 
-// Fetch departures from API
-bool fetchDepartures(JsonDocument &doc) {
-  HTTPClient http;
+// Field metrics, registered in registerMetrics() and published by the
+// network task every metrics interval
+int fetchOkMetric = -1;
+int fetchNotModifiedMetric = -1;
+int fetchFailedMetric = -1;
+int pushMetric = -1;
+int fetchDnsMetric = -1;
+int fetchConnectMetric = -1;
+int fetchWaitMetric = -1;
+int fetchBodyMetric = -1;
+int parseMetric = -1;
+int payloadMetric = -1;
+int jsonArenaMetric = -1;
+int frameDrawMetric = -1;
+int framePresentMetric = -1;
+int freeHeapMetric = -1;
+int largestBlockMetric = -1;
+int wifiConnectMetric = -1;
+
+void registerMetrics() {
+  fetchOkMetric = metrics.addCounter("fetch_ok");
+  fetchNotModifiedMetric = metrics.addCounter("fetch_not_modified");
+  fetchFailedMetric = metrics.addCounter("fetch_failed");
+  pushMetric = metrics.addCounter("push_applied");
+
+  // TLS has no histogram of its own: WiFiClientSecure does the TCP connect
+  // and the handshake in one call, so fetch_connect_ms covers both
+  fetchDnsMetric = metrics.addHistogram("fetch_dns_ms", LATENCY_BUCKETS_MS, 8);
+  fetchConnectMetric =
+      metrics.addHistogram("fetch_connect_ms", LATENCY_BUCKETS_MS, 8);
+  fetchWaitMetric = metrics.addHistogram("fetch_wait_ms", LATENCY_BUCKETS_MS, 8);
+  fetchBodyMetric = metrics.addHistogram("fetch_body_ms", LATENCY_BUCKETS_MS, 8);
+  parseMetric = metrics.addHistogram("parse_us", DURATION_BUCKETS_US, 8);
+  payloadMetric =
+      metrics.addHistogram("payload_bytes", SIZE_BUCKETS_BYTES, 6);
+  jsonArenaMetric =
+      metrics.addHistogram("json_arena_bytes", SIZE_BUCKETS_BYTES, 6);
+  frameDrawMetric =
+      metrics.addHistogram("frame_draw_us", DURATION_BUCKETS_US, 8);
+  framePresentMetric =
+      metrics.addHistogram("frame_present_us", DURATION_BUCKETS_US, 8);
+
+  // Boot to associated, with the cached access point or after a scan
+  wifiConnectMetric =
+      metrics.addHistogram("wifi_connect_ms", LATENCY_BUCKETS_MS, 8);
+
+  freeHeapMetric = metrics.addLowWaterMark("free_heap");
+  largestBlockMetric = metrics.addLowWaterMark("largest_free_block");
+}
 
-  String url = String(Config::getApiUrl()) +
-               "/departures?lat=" + String(Config::getGeoLat()) +
-               "&lon=" + String(Config::getGeoLon());
+// Heap low-water marks, sampled where the heap is lowest: while a parsed
+// document is still alive, and once per metrics report
+void sampleHeap() {
+  metrics.recordLow(freeHeapMetric, ESP.getFreeHeap());
+  metrics.recordLow(largestBlockMetric, ESP.getMaxAllocHeap());
+}
 
-  // Log API request
-  String logMsg = "API request: " + url;
-  log(LOG_DEBUG, logMsg.c_str());
+// Keep a response header in a fixed buffer. A value too long for it is
+// dropped, which only costs a full response next time.
+void saveHeader(char *dest, size_t size, HTTPClient &http, const char *name) {
+  String value = http.header(name);
+  if (value.length() < size) {
+    memcpy(dest, value.c_str(), value.length() + 1);
+  } else {
+    dest[0] = '\0';
+  }
+}
 
-  // Create client and track pointer for cleanup
-  WiFiClient *client = nullptr;
-  if (url.startsWith("https://")) {
-    client = createSecureClient();
-    http.begin(*static_cast<WiFiClientSecure *>(client), url);
+// Fetch departures from API and decode them into board
+// Sends the validators of the last decoded board so an unchanged response
+// costs a 304 and no parsing. The JSON document only lives for this call.
+FetchResult fetchDepartures(DepartureBoard &board) {
+  // Nothing else lives in the arena, start it over for this document
+  jsonArena.reset();
+  JsonDocument doc(&jsonArena);
+
+  LOG_DEBUG("API request: %s%s", Config::getApiUrl(), departuresPath);
+
+  int httpCode = apiConnection.get(departuresPath, departuresEtag,
+                                   departuresLastModified);
+  HTTPClient &http = apiConnection.http();
+
+  FetchResult result = FETCH_FAILED;
+  if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+    result = FETCH_NOT_MODIFIED;
+  } else if (httpCode == HTTP_CODE_OK) {
+    // Server picks the encoding from our Accept header
+    bool msgpack = http.header("Content-Type").startsWith("application/msgpack");
+    int payloadSize = http.getSize();
+    unsigned long parseStartMs = millis();
+
+    DeserializationError error;
+    if (payloadSize >= 0) {
+      // Known Content-Length: parse straight off the socket instead of
+      // buffering the body in a String. Parsing overlaps the download, so
+      // only fetch_body_ms is recorded.
+      error = msgpack ? parseDeparturesMsgPack(http.getStream(), doc)
+                      : parseDepartures(http.getStream(), doc);
+    } else {
+      // Chunked response, let HTTPClient strip the chunk framing
+      String payload = http.getString();
+      payloadSize = payload.length();
+      unsigned long startUs = micros();
+      error = msgpack ? parseDeparturesMsgPack(payload, doc)
+                      : parseDepartures(payload, doc);
+      metrics.record(parseMetric, micros() - startUs);
+    }
+    metrics.record(fetchBodyMetric, millis() - parseStartMs);
+    metrics.record(payloadMetric, payloadSize);
+    sampleHeap();
+    metrics.record(jsonArenaMetric, jsonArena.used());
+
+    // Log payload size and parse time per encoding
+    LOG_DEBUG("API payload: %s %d bytes, parsed in %lums",
+              msgpack ? "msgpack" : "json", payloadSize,
+              millis() - parseStartMs);
+
+    if (error || !decodeDepartures(doc, board, millis(), time(nullptr))) {
+      LOG_ERROR("API JSON parse failed: %s",
+                error ? error.c_str() : "no routes");
+
+      // board no longer matches the validators
+      departuresEtag[0] = '\0';
+      departuresLastModified[0] = '\0';
+    } else {
+      saveHeader(departuresEtag, sizeof(departuresEtag), http, "ETag");
+      saveHeader(departuresLastModified, sizeof(departuresLastModified), http,
+                 "Last-Modified");
+      result = FETCH_OK;
+    }
   } else {
-    client = createClient();
-    http.begin(*client, url);
+    // Log HTTP error with the start of the response body (the log entry
+    // truncates the rest). Only a body of known length is read, so a short
+    // one on a kept-alive connection doesn't wait for the read timeout.
+    char responseBody[LOG_MESSAGE_SIZE] = "";
+    int bodySize = httpCode > 0 ? http.getSize() : -1;
+    if (bodySize > 0) {
+      size_t n = http.getStream().readBytes(
+          responseBody, min(bodySize, (int)sizeof(responseBody) - 1));
+      responseBody[n] = '\0';
+    }
+    LOG_ERROR("API request failed: HTTP %d%s%s", httpCode,
+              responseBody[0] ? " - " : "", responseBody);
   }
 
-  // Add API key header
-  http.addHeader("x-api-key", Config::getApiSecret());
+  apiConnection.end();
 
-  int httpCode = http.GET();
+  // Record and log connection reuse and handshake cost
+  const FetchStats &stats = apiConnection.stats();
+  if (httpCode > 0 && !stats.reused) {
+    metrics.record(fetchDnsMetric, stats.dnsMs);
+    metrics.record(fetchConnectMetric, stats.connectMs);
+  }
+  if (httpCode > 0) {
+    metrics.record(fetchWaitMetric, stats.requestMs);
+  }
+  LOG_DEBUG("API connection: reused=%s, connect %lums, request %lums",
+            stats.reused ? "yes" : "no", (unsigned long)stats.connectMs,
+            (unsigned long)stats.requestMs);
 
-  bool success = false;
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    DeserializationError error = deserializeJson(doc, payload);
+  return result;
+}
 
-    if (error) {
-      // Log JSON parse error
-      String logMsg = "API JSON parse failed: " + String(error.c_str());
-      log(LOG_ERROR, logMsg.c_str());
-    } else {
-      success = true;
-    }
+// Save the departures in board to NVS (network task). Throttled to one
+// write per SNAPSHOT_SAVE_INTERVAL_MS; in between, updates aren't saved.
+void saveSnapshot(const DepartureBoard &board) {
+  static bool saved = false;
+  static uint32_t lastSaveMs = 0;
+  if (saved && millis() - lastSaveMs < SNAPSHOT_SAVE_INTERVAL_MS) {
+    return;
+  }
+
+  static uint8_t data[SNAPSHOT_MAX_BYTES];
+  size_t length =
+      encodeSnapshot(board, millis(), time(nullptr), data, sizeof(data));
+  Preferences prefs;
+  if (length == 0 || !prefs.begin("departures", false)) {
+    return;
+  }
+  bool written = prefs.putBytes("board", data, length) == length;
+  prefs.end();
+  if (written) {
+    saved = true;
+    lastSaveMs = millis();
+    LOG_DEBUG("Departures saved: %u bytes", (unsigned)length);
+  }
+}
+
+// Snapshot restored before the clock was set, kept until runTimeSync() can
+// tell its age (network task). Length 0 once handled, or once fresh
+// departures have replaced it.
+uint8_t unagedSnapshot[SNAPSHOT_MAX_BYTES];
+size_t unagedSnapshotLength = 0;
+
+// Publish the departures saved before the reboot, if there are any that
+// aren't known to be too old. Returns true if a snapshot was published.
+bool restoreSnapshot() {
+  uint8_t *data = unagedSnapshot;
+  Preferences prefs;
+  if (!prefs.begin("departures", true)) {
+    return false;
+  }
+  size_t length = prefs.getBytes("board", data, sizeof(unagedSnapshot));
+  prefs.end();
+  if (length == 0) {
+    return false;
+  }
+
+  // The clock survives a software reset, but not a power cycle
+  time_t now = time(nullptr);
+  uint32_t nowEpoch = now >= MIN_VALID_TIME ? now : 0;
+  uint32_t savedEpoch = snapshotEpoch(data, length);
+  if (nowEpoch && savedEpoch && nowEpoch - savedEpoch > MAX_RESTORE_AGE_S) {
+    LOG_INFO("Saved departures are %lus old, not shown",
+             (unsigned long)(nowEpoch - savedEpoch));
+    return false;
+  }
+
+  BoardSnapshot &snapshot = snapshots.back();
+  if (!decodeSnapshot(data, length, snapshot.board, millis(), nowEpoch)) {
+    LOG_WARN("Saved departures unreadable, ignored");
+    return false;
+  }
+  snapshot.publishedMs = millis();
+  snapshot.restored = true;
+  snapshots.publish();
+  unagedSnapshotLength = savedEpoch && !nowEpoch ? length : 0;
+  LOG_INFO("Restored %d routes saved before reboot%s",
+           snapshot.board.routeCount,
+           nowEpoch && savedEpoch ? "" : " (unaged)");
+  return true;
+}
+
+/* Function to display splash screen at startup
+ * It stays up until the first departures page replaces it. */
+void displaySplash(Renderer *canvas) {
+  canvas->fillScreen(0);
+  unsigned long startUs = micros();
+  canvas->drawAsset(SPLASH, 0, 0);
+  unsigned long blitUs = micros() - startUs;
+  canvas->present();
+  LOG_INFO("Splash: %lu bytes in flash, decoded in %luus",
+           (unsigned long)SPLASH_FLASH_BYTES, blitUs);
+}
+
+/* Timed jobs
+ * The network task (core 0) fetches, decodes and publishes snapshots and
+ * keeps MQTT alive. The render task (Arduino loop, core 1) only reads the
+ * latest snapshot, so pages keep turning while a request or TLS handshake
+ * is in progress. */
+Scheduler networkScheduler([]() -> uint32_t { return millis(); });
+Scheduler renderScheduler([]() -> uint32_t { return millis(); });
+int wifiJob = -1;
+int fetchJob = -1;
+int mqttJob = -1;
+int timeJob = -1;
+int logJob = -1;
+int metricsJob = -1;
+int pageJob = -1;
+int messageJob = -1;
+int messagePage = 0;
+bool rotationStarted = false;
+bool haveSnapshot = false; // Set once the first snapshot was picked up
+volatile bool wifiFailing = false; // Network task: the last connect failed
+
+// Fetch departures and publish them to the render task (network task)
+void runFetch() {
+  LOG_INFO("Fetching departures from API");
+  BoardSnapshot &snapshot = snapshots.back();
+  FetchResult result = fetchDepartures(snapshot.board);
+
+  uint32_t nextFetchMs;
+  if (result == FETCH_FAILED) {
+    nextFetchMs = pollingPolicy->onFailure();
+    metrics.increment(fetchFailedMetric);
+    LOG_ERROR("Failed to fetch departures, retrying in %lus",
+              (unsigned long)(nextFetchMs / 1000));
+  } else if (result == FETCH_NOT_MODIFIED) {
+    // The render task already has this data
+    LOG_INFO("Departures not modified, keeping current data");
+    nextFetchMs = pollingPolicy->onNotModified(millis());
+    metrics.increment(fetchNotModifiedMetric);
   } else {
-    // Log HTTP error with response body
-    String responseBody = http.getString();
-    String logMsg = "API request failed: HTTP " + String(httpCode);
-    if (responseBody.length() > 0 && responseBody.length() < 200) {
-      logMsg += " - " + responseBody;
-    } else if (responseBody.length() > 0) {
-      logMsg += " - " + responseBody.substring(0, 200) + "...";
-    }
-    log(LOG_ERROR, logMsg.c_str());
+    // Log success with route count
+    LOG_INFO("Departures fetched successfully: %d routes",
+             snapshot.board.routeCount);
+
+    nextFetchMs = pollingPolicy->onSuccess(snapshot.board, millis());
+    metrics.increment(fetchOkMetric);
+    saveSnapshot(snapshot.board);
+    snapshot.publishedMs = millis();
+    snapshot.restored = false;
+    snapshots.publish();
+    unagedSnapshotLength = 0;
+    markBoot(BOOT_FIRST_FETCH);
+  }
+
+  networkScheduler.schedule(fetchJob, nextFetchMs);
+}
+
+// Apply a snapshot pushed over MQTT (network task, from runMqtt). The
+// backend publishes the same body GET /departures serves, as JSON or the
+// compact MessagePack encoding.
+void applyPushedDepartures(const byte *payload, unsigned int length) {
+  jsonArena.reset();
+  JsonDocument doc(&jsonArena);
+  bool isJson = length > 0 && payload[0] == '{';
+  unsigned long startUs = micros();
+  DeserializationError error = isJson
+                                   ? parseDepartures(payload, length, doc)
+                                   : parseDeparturesMsgPack(payload, length, doc);
+  metrics.record(parseMetric, micros() - startUs);
+  metrics.record(payloadMetric, length);
+  sampleHeap();
+  metrics.record(jsonArenaMetric, jsonArena.used());
+  if (error) {
+    LOG_ERROR("Pushed departures parse failed: %s", error.c_str());
+    return;
   }
 
-  http.end();
-  delete client; // Free the allocated client memory
+  // Nothing is published on failure: the board, the HTTP validators and the
+  // fetch schedule stay as they were
+  BoardSnapshot &snapshot = snapshots.back();
+  if (!decodeDepartures(doc, snapshot.board, millis(), time(nullptr))) {
+    LOG_ERROR("Pushed departures have no routes");
+    return;
+  }
+  saveSnapshot(snapshot.board);
+  snapshot.publishedMs = millis();
+  snapshot.restored = false;
+  snapshots.publish();
+  unagedSnapshotLength = 0;
+  metrics.increment(pushMetric);
+
+  // The HTTP validators describe an older board now
+  departuresEtag[0] = '\0';
+  departuresLastModified[0] = '\0';
+
+  // Pushes keep HTTP polling deferred; it resumes if they stop arriving
+  networkScheduler.schedule(fetchJob, Config::getPollMaxMs());
+
+  LOG_INFO("Departures pushed: %d routes, %u bytes",
+           snapshot.board.routeCount, length);
+}
 
-  return success;
+// Keep the MQTT connection serviced between fetches (network task)
+void runMqtt() {
+  // The broker's certificate can't be checked before NTP sets the clock
+  if (!bootTimeline.reached(BOOT_TIME)) {
+    return;
+  }
+  if (maintainAwsIotConnection()) {
+    markBoot(BOOT_MQTT);
+  }
 }
 
-void displayDirection(MatrixPanel_I2S_DMA *display, JsonObject direction,
-                      const char *color) {
-  const char *headsign = direction["headsign"];
-  JsonArray departures = direction["departures"];
+// Connect to WiFi until it works, then start the jobs that need it
+// (network task). The render task keeps showing the restored board, or the
+// error screen if there is none, in the meantime.
+void runWiFi() {
+  if (!setupWiFi(Config::getWifiSSID(), Config::getWifiPassword(),
+                 Config::getWifiReuseLease())) {
+    wifiFailing = true;
+    networkScheduler.schedule(wifiJob, WIFI_RETRY_MS);
+    return;
+  }
+  wifiFailing = false;
+  metrics.record(wifiConnectMetric, wifiConnectStats().connectMs);
+  markBoot(BOOT_WIFI);
+
+  // Start NTP sync in the background (required for TLS certificate
+  // validation of AWS IoT, not for fetches). runTimeSync() waits for it.
+  // Set timezone to US Central with automatic DST handling
+  configTime(-6 * 3600, 3600, "pool.ntp.org", "time.nist.gov");
+  setenv("TZ", "CST6CDT,M3.2.0,M11.1.0", 1);
+  tzset();
+
+  // First fetch right away, MQTT as soon as NTP is done. The fetch doesn't
+  // need the clock: the API certificate isn't checked and departures fall
+  // back to their minutes field without it.
+  networkScheduler.schedule(fetchJob, 0);
+  networkScheduler.schedule(timeJob, TIME_CHECK_MS);
+  networkScheduler.schedule(mqttJob, 100);
+}
 
-  String displayHeadsign = String(headsign);
-  displayHeadsign.toUpperCase();
-  if (displayHeadsign.length() > HEADSIGN_WIDTH) {
-    displayHeadsign = displayHeadsign.substring(0, HEADSIGN_WIDTH);
+// Age the departures restored before the clock was set, now that it is, or
+// take them off the board if they turn out to be too old (network task)
+void ageRestoredSnapshot(uint32_t nowEpoch) {
+  size_t length = unagedSnapshotLength;
+  unagedSnapshotLength = 0;
+  uint32_t ageS = nowEpoch - snapshotEpoch(unagedSnapshot, length);
+
+  BoardSnapshot &snapshot = snapshots.back();
+  if (ageS > MAX_RESTORE_AGE_S) {
+    snapshot.board.routeCount = 0;
+    snapshot.board.messageLineCount = 0;
+    LOG_INFO("Restored departures are %lus old, taken down",
+             (unsigned long)ageS);
+  } else if (decodeSnapshot(unagedSnapshot, length, snapshot.board, millis(),
+                            nowEpoch)) {
+    LOG_INFO("Restored departures aged by %lus", (unsigned long)ageS);
   } else {
-    // Pad with spaces to HEADSIGN_WIDTH characters
-    while (displayHeadsign.length() < HEADSIGN_WIDTH) {
-      displayHeadsign += " ";
+    return;
+  }
+  snapshot.publishedMs = millis();
+  snapshot.restored = true;
+  snapshots.publish();
+}
+
+// Wait for NTP to set the clock, then stop (network task). SNTP runs in
+// the background from configTime() on; nothing here blocks.
+void runTimeSync() {
+  time_t now = time(nullptr);
+  if (now < MIN_VALID_TIME) {
+    static bool reported = false;
+    if (!reported &&
+        millis() - bootTimeline.at(BOOT_WIFI) >= NTP_TIMEOUT_MS) {
+      LOG_ERROR("NTP sync failed, still waiting");
+      reported = true;
     }
+    return;
   }
 
-  // Display bullet prefix in white
-  display->setTextColor(display->color565(255, 255, 255));
-  display->print("|");
+  // Log NTP sync with current time
+  struct tm timeinfo;
+  localtime_r(&now, &timeinfo);
+  char timeStr[64];
+  strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
+  LOG_INFO("NTP sync successful: %s", timeStr);
+
+  // Still showing a board restored without a clock: nothing fetched or
+  // pushed has replaced it yet
+  if (unagedSnapshotLength > 0) {
+    ageRestoredSnapshot(now);
+  }
 
-  // Display headsign in route color
-  display->setTextColor(hexToColor565(color));
-  display->print(displayHeadsign);
+  markBoot(BOOT_TIME);
+  networkScheduler.cancel(timeJob);
+}
 
-  // Display separator in white
-  display->setTextColor(display->color565(255, 255, 255));
-  display->print(" ");
+// Report field metrics (network task)
+void runMetrics() {
+  sampleHeap();
+  publishMetrics();
+}
 
-  int depCount = 0;
+// Start of a rotation: take the newest snapshot, show the message if due
+// (render task). Returns false if a message page was scheduled instead.
+bool startRotation() {
+  if (snapshots.update()) {
+    haveSnapshot = true;
 
-  for (JsonObject dep : departures) {
-    if (depCount == 3)
-      break;
+    // Log how long the snapshot waited for a rotation boundary
+    LOG_DEBUG("Render picked up departures after %lums",
+              millis() - snapshots.front().publishedMs);
+  }
 
-    const char *type = dep["type"];
-    int minutes = dep["minutes"];
+  // Log any stall that held pages up during the last rotation
+  uint32_t stallMs = renderScheduler.takeMaxLatenessMs();
+  if (stallMs > 50) {
+    LOG_WARN("Render stalled for %lums", (unsigned long)stallMs);
+  }
 
-    if (depCount > 0) {
-      // Comma always in white
-      display->setTextColor(display->color565(255, 255, 255));
-      display->print(",");
-    }
+  const DepartureBoard &board = snapshots.front().board;
+  currentRouteIndex = 0;
+  rotationStarted = true;
 
-    // Set color based on departure type
-    if (strcmp(type, "RealTime") == 0) {
-      display->setTextColor(hexToColor565(TRANSIT_COLOR));
-    } else {
-      display->setTextColor(display->color565(255, 255, 255));
+  // Check if there's a message to display
+  if (board.messageLineCount > 0) {
+    unsigned long currentTime = millis();
+    unsigned long elapsed = currentTime - lastMessageTimeMs;
+
+    if (elapsed >= Config::getMessageIntervalMs()) {
+      LOG_DEBUG("Message to display: %d lines", board.messageLineCount);
+      messagePage = 0;
+      renderScheduler.schedule(messageJob, 0);
+      return false;
     }
 
-    display->print(minutes);
+    // Log message skip
+    LOG_DEBUG("Skipping message display, elapsed: %lums, interval: %dms",
+              elapsed, Config::getMessageIntervalMs());
+  }
+
+  return true;
+}
 
-    depCount++;
+// Show the next message page, then hand over to the departure pages
+// (render task)
+void runMessagePage() {
+  const DepartureBoard &board = snapshots.front().board;
+  if (messagePage >= messagePageCount(board)) {
+    lastMessageTimeMs = millis();
+    LOG_INFO("Message displayed");
+    renderScheduler.schedule(pageJob, 0);
+    return;
   }
-  display->print("\n");
+
+  canvas->fillScreen(0);
+  drawMessagePage(canvas->text(), board, messagePage);
+  canvas->present();
+
+  renderScheduler.schedule(messageJob, messagePageMs(board, messagePage));
+  messagePage++;
 }
 
-/* Function to display a message on the LED matrix */
-void displayMessage(MatrixPanel_I2S_DMA *display, JsonArray messageLines) {
-  int totalLines = messageLines.size();
-  int linesPerPage = 6;
-
-  if (totalLines <= linesPerPage) {
-    // Single page - display all lines for 10s
-    display->fillScreen(0);
-    display->setCursor(0, 0);
-    display->setTextColor(hexToColor565(MESSAGE_COLOR));
-    for (JsonVariant line : messageLines) {
-      const char *lineText = line.as<const char *>();
-      display->println(lineText);
-    }
-    delay(20000);
-  } else {
-    // Two pages - 5s each for 10s total
-    // Page 1: lines 0-5
-    display->fillScreen(0);
-    display->setCursor(0, 0);
-    display->setTextColor(hexToColor565(MESSAGE_COLOR));
-    for (int i = 0; i < linesPerPage && i < totalLines; i++) {
-      const char *lineText = messageLines[i].as<const char *>();
-      display->println(lineText);
-    }
-    delay(15000);
-
-    // Page 2: lines 6-11
-    display->fillScreen(0);
-    display->setCursor(0, 0);
-    display->setTextColor(hexToColor565(MESSAGE_COLOR));
-    for (int i = linesPerPage; i < totalLines; i++) {
-      const char *lineText = messageLines[i].as<const char *>();
-      display->println(lineText);
-    }
-    delay(5000);
+// While there is nothing to show, put up the WiFi error screen when connects
+// fail and the splash back once one gets through (render task)
+void showWiFiStatus() {
+  static bool errorShown = false;
+  bool failing = wifiFailing;
+  if (failing == errorShown) {
+    return;
+  }
+  errorShown = failing;
+  if (!failing) {
+    displaySplash(canvas);
+    return;
   }
+
+  canvas->fillScreen(0);
+  canvas->setCursor(0, 0);
+  canvas->setTextWrap(true);
+  canvas->setTextColor(ERROR_COLOR);
+  canvas->println("WiFi error: ");
+  canvas->println("");
+  canvas->setTextColor(WHITE_COLOR);
+  canvas->println(Config::getWifiSSID());
+  canvas->setTextWrap(false);
+  canvas->present();
 }
 
-/* Function to display a route on the LED matrix */
-void displayRoute(MatrixPanel_I2S_DMA *display, JsonObject route) {
-  const char *name = route["name"];
-  String routeName = String(name);
-  const char *mode = route["mode"];
-  String routeMode = String(mode);
-  const char *color = route["color"];
-
-  // Display route name and mode in route color
-  display->setTextColor(hexToColor565(color));
-  routeName.toUpperCase();
-  display->print(routeName);
-  display->print(" ");
-  display->print(routeMode);
-  display->print("\n");
-
-  JsonArray directions = route["directions"];
-
-  // Display first two directions (or less if not available)
-  for (int i = 0; i < 2; i++) {
-    if (i < directions.size()) {
-      JsonObject direction = directions[i];
-      displayDirection(display, direction, color);
-    } else {
-      // Write empty line if direction doesn't exist
-      display->print("\n");
-    }
+// Show the next pair of routes (render task)
+void runPage() {
+  if (!rotationStarted && !startRotation()) {
+    return;
+  }
+
+  // Nothing fetched yet, check again shortly
+  if (!haveSnapshot) {
+    showWiFiStatus();
+    rotationStarted = false;
+    renderScheduler.schedule(pageJob, 100);
+    return;
+  }
+
+  const DepartureBoard &board = snapshots.front().board;
+
+  // Display two routes starting from currentRouteIndex on a cleared frame
+  canvas->fillScreen(0);
+  uint32_t nowMs = millis();
+  unsigned long drawStartUs = micros();
+  drawRoutePage(canvas->text(), board, currentRouteIndex, nowMs);
+  unsigned long presentStartUs = micros();
+  metrics.record(frameDrawMetric, presentStartUs - drawStartUs);
+
+  // Only the cells that changed since the last page reach the panel
+  canvas->present();
+  metrics.record(framePresentMetric, micros() - presentStartUs);
+  LOG_DEBUG("Frame pixels written: %lu",
+            (unsigned long)canvas->lastPixelsWritten());
+
+  // Log the whole boot once live departures are up
+  if (!snapshots.front().restored && bootTimeline.mark(BOOT_FIRST_PAGE)) {
+    char timeline[LOG_MESSAGE_SIZE];
+    bootTimeline.format(timeline, sizeof(timeline));
+    LOG_INFO("Boot timeline (ms): %s", timeline);
+  }
+
+  // Move to next pair of routes
+  currentRouteIndex += ROUTES_PER_PAGE;
+
+  // Loop back to start when we reach the end
+  if (currentRouteIndex >= board.routeCount) {
+    rotationStarted = false;
   }
+
+  renderScheduler.schedule(pageJob, Config::getPageIntervalMs());
 }
 
-/* Function to display splash screen at startup */
-void displaySplash(MatrixPanel_I2S_DMA *display) {
-  display->fillScreen(0);
-  for (int y = 0; y < SPLASH_HEIGHT; y++) {
-    for (int x = 0; x < SPLASH_WIDTH; x++) {
-      uint16_t color = SPLASH_BITMAP[y * SPLASH_WIDTH + x];
-      display->drawPixel(x, y, color);
+// alloc_debug builds: heap allocations made by one loop iteration of the
+// calling task since before (always 0 otherwise)
+uint32_t allocationsSince(uint32_t before) { return allocCount() - before; }
+
+// Network task body, pinned to core 0
+void networkTask(void *parameter) {
+  allocTrackTask();
+  for (;;) {
+    // Fetches still allocate inside HTTPClient and for the JSON document;
+    // everything else on this task shouldn't
+    uint32_t before = allocCount();
+    uint32_t idleMs = networkScheduler.runDue();
+    uint32_t made = allocationsSince(before);
+    if (made > 0) {
+      LOG_DEBUG("Network loop iteration: %lu heap allocations",
+                (unsigned long)made);
     }
+    delay(idleMs);
   }
-  delay(3000);
 }
 
 void setup(void) {
@@ -232,182 +699,126 @@ void setup(void) {
   // Dot notation: object.method() - calls a function that belongs to that
   // object
   Serial.begin(115200);
-  delay(2000); // Give serial time to connect
-
-  // Initialize configuration
-  if (!Config::begin()) {
-    Serial.println("Config init failed");
-    for (;;)
-      ;
+  logBegin([]() -> uint32_t { return millis(); });
+  allocTrackTask();
+  registerMetrics();
+  // No waiting for a serial monitor: log messages are held in the log ring
+  // until the network task flushes them
+
+  // Create display object with the configured color depth and timing
+  const DisplayProfile *profile =
+      findDisplayProfile(Config::getDisplayProfile());
+  if (!profile) {
+    profile = &defaultDisplayProfile();
+    LOG_WARN("Unknown display profile %s, using %s",
+             Config::getDisplayProfile(), profile->name);
   }
-
-  // Create display object
-  display = createDisplay();
+  display = createDisplay(*profile);
 
   // Call .begin() METHOD on display object
+  size_t dmaFreeBefore = heap_caps_get_free_size(MALLOC_CAP_DMA);
   if (!display->begin()) {
     Serial.println("DMA init failed");
     for (;;)
       ;
   }
 
-  display->setBrightness8(120);
-  display->setTextSize(1);
-  display->setTextWrap(true);
-
-  // Display splash screen first
-  displaySplash(display);
-
-  // Connect to WiFi
-  while (!setupWiFi(Config::getWifiSSID(), Config::getWifiPassword())) {
-    display->fillScreen(0);
-    display->setCursor(0, 0);
-    display->setTextColor(hexToColor565(ERROR_COLOR));
-    display->println("WiFi error: ");
-    display->println("");
-    display->setTextColor(display->color565(255, 255, 255));
-    display->println(Config::getWifiSSID());
-    delay(5000);
-  }
-
-  // Show WiFi connected message while doing NTP and IoT setup
-  display->fillScreen(0);
-  display->setCursor(0, 0);
-  display->setTextColor(display->color565(255, 255, 255));
-  display->println("WiFi connected:");
-  display->println("");
-  display->setTextColor(hexToColor565(TRANSIT_COLOR));
-  display->println(Config::getWifiSSID());
-
-  // Sync time with NTP (required for TLS certificate validation)
-  // Set timezone to US Central with automatic DST handling
-  configTime(-6 * 3600, 3600, "pool.ntp.org", "time.nist.gov");
-  setenv("TZ", "CST6CDT,M3.2.0,M11.1.0", 1);
-  tzset();
+  // Log what the profile costs, to pick the cheapest one that looks right.
+  // The driver has no refresh counter; the rate is its timing model's.
+  size_t dmaBytes = dmaFreeBefore - heap_caps_get_free_size(MALLOC_CAP_DMA);
+  uint32_t refreshHz = estimateRefreshHz(*profile, PANEL_WIDTH, PANEL_HEIGHT);
+  LOG_INFO("Display profile %s: %u-bit, %luMHz, DMA %u bytes, ~%luHz (min %u)",
+           profile->name, profile->colorDepthBits,
+           (unsigned long)(profile->i2sSpeedHz / 1000000), (unsigned)dmaBytes,
+           (unsigned long)refreshHz, profile->minRefreshHz);
 
-  time_t now = 0;
-  struct tm timeinfo;
-  int retry = 0;
-  while (now < 1000000000 && retry < 20) {
-    time(&now);
-    delay(500);
-    retry++;
-  }
+  display->setBrightness8(120);
 
-  bool ntp_failed = false;
-  if (now < 1000000000) {
-    log(LOG_ERROR, "NTP sync failed");
-    ntp_failed = true;
-  } else {
-    localtime_r(&now, &timeinfo);
-    Serial.print("Current time: ");
-    Serial.println(asctime(&timeinfo));
-
-    // Log NTP sync with current time
-    char timeStr[64];
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
-    String logMsg = String("NTP sync successful: ") + timeStr;
-    log(LOG_INFO, logMsg.c_str());
-  }
-
-  // Initialize AWS IoT if enabled
-  bool iot_failed = false;
-  if (Config::isAwsIotEnabled()) {
-    if (!setupAwsIot()) {
-      log(LOG_ERROR, "AWS IoT connection failed");
-      iot_failed = true;
-    } else {
-      log(LOG_INFO, "AWS IoT connected");
-    }
+  // Everything is drawn off-screen and presented as a diff
+  canvas = new Renderer(display);
+  if (!canvas->begin()) {
+    Serial.println("Frame buffer allocation failed");
+    for (;;)
+      ;
   }
-
-  // Show errors if any occurred
-  if (ntp_failed || iot_failed) {
-    display->fillScreen(0);
-    display->setCursor(0, 0);
-    display->setTextColor(hexToColor565(ERROR_COLOR));
-    if (ntp_failed) {
-      display->println("NTP sync failed!");
-    }
-    if (iot_failed) {
-      display->println("AWS IoT failed");
-    }
-    delay(3000);
+  canvas->setTextSize(1);
+  canvas->setTextWrap(false);
+
+  // Render jobs: pages start as soon as the first snapshot arrives
+  pageJob = renderScheduler.add("page", runPage, 0);
+  messageJob =
+      renderScheduler.add("message", runMessagePage, 0, Scheduler::NEVER);
+
+  // Show the departures saved before the reboot right away, counting down,
+  // until the first fetch replaces them. Otherwise the splash stays up while
+  // the network task works toward that fetch.
+  displaySplash(canvas);
+  markBoot(BOOT_DISPLAY);
+  if (restoreSnapshot()) {
+    renderScheduler.runDue();
+    markBoot(BOOT_RESTORED);
   }
 
-  display->fillScreen(0);
-  display->setCursor(0, 0);
-  display->setTextWrap(false);
-}
-
-void loop() {
-  // Maintain AWS IoT connection
-  maintainAwsIotConnection();
-
-  // Fetch departures from API only at start of cycle
-  if (currentRouteIndex == 0) {
-    log(LOG_INFO, "Fetching departures from API");
-    if (!fetchDepartures(globalDoc)) {
-      log(LOG_ERROR, "Failed to fetch departures, retrying in 10s");
-      delay(10000);
-      return;
-    }
-
-    JsonArray routes = globalDoc["routes"];
-    totalRoutes = routes.size();
+  apiConnection.begin(Config::getApiUrl(), Config::getApiSecret());
+  // Prefer the compact binary encoding, older servers fall back to JSON
+  apiConnection.setAccept("application/msgpack, application/json;q=0.5");
+  snprintf(departuresPath, sizeof(departuresPath), "/departures?lat=%s&lon=%s",
+           Config::getGeoLat(), Config::getGeoLon());
 
-    // Log success with route count
-    String logMsg = String("Departures fetched successfully: ") + String(totalRoutes) + " routes";
-    log(LOG_INFO, logMsg.c_str());
-
-    // Check if there's a message to display
-    JsonArray message = globalDoc["message"];
-    if (!message.isNull()) {
-      unsigned long currentTime = millis();
-      unsigned long elapsed = currentTime - lastMessageTimeMs;
-
-      if (elapsed >= Config::getMessageIntervalMs()) {
-        Serial.println("Message to display:");
-        for (JsonVariant line : message) {
-          Serial.println(line.as<const char *>());
-        }
-        displayMessage(display, message);
-        lastMessageTimeMs = millis();
-        log(LOG_INFO, "Message displayed");
-      } else {
-        // Log message skip
-        String logMsg = String("Skipping message display, elapsed: ") +
-                       String(elapsed) + "ms, interval: " +
-                       String(Config::getMessageIntervalMs()) + "ms";
-        log(LOG_DEBUG, logMsg.c_str());
-      }
-    }
+  // Configured here, connected by the mqtt job once the clock is set
+  if (Config::isAwsIotEnabled() && !setupAwsIot()) {
+    LOG_ERROR("AWS IoT setup failed");
   }
 
-  // Clear screen and reset cursor
-  display->fillScreen(0);
-  display->setCursor(0, 0);
-  display->setTextColor(display->color565(255, 255, 255));
-
-  // Display two routes starting from currentRouteIndex
-  JsonArray routes = globalDoc["routes"];
-  for (int i = 0; i < 2 && (currentRouteIndex + i) < totalRoutes; i++) {
-    JsonObject route = routes[currentRouteIndex + i];
-    displayRoute(display, route);
+  // JSON documents go to PSRAM, leaving internal RAM to DMA and TLS
+  void *arena = ps_malloc(JSON_ARENA_SIZE);
+  if (arena) {
+    jsonArena.begin(arena, JSON_ARENA_SIZE);
+  } else {
+    LOG_WARN("No PSRAM, JSON documents use the heap");
   }
 
-  // Move to next pair of routes
-  currentRouteIndex += 2;
-
-  // Loop back to start when we reach the end
-  if (currentRouteIndex >= totalRoutes) {
-    currentRouteIndex = 0;
-  }
+  PollingBounds pollingBounds = {
+      Config::getPollMinMs(),
+      Config::getPollMaxMs(),
+      Config::getPollRealtimeMs(),
+      Config::getPollRetryMs(),
+      Config::getPollBackoffMaxMs(),
+  };
+  pollingPolicy = new PollingPolicy(pollingBounds, esp_random);
+  setDeparturesHandler(applyPushedDepartures);
+
+  // Network jobs: WiFi first, everything that needs it starts once it is
+  // connected (runWiFi)
+  wifiJob = networkScheduler.add("wifi", runWiFi, 0);
+  fetchJob = networkScheduler.add("fetch", runFetch, 0, Scheduler::NEVER);
+  timeJob = networkScheduler.add("time", runTimeSync, TIME_CHECK_MS,
+                                 Scheduler::NEVER);
+  mqttJob = networkScheduler.add("mqtt", runMqtt, 100, Scheduler::NEVER);
+  logJob = networkScheduler.add("log", flushLogs, LOG_FLUSH_MS);
+  metricsJob = networkScheduler.add("metrics", runMetrics,
+                                    Config::getMetricsIntervalMs(),
+                                    Config::getMetricsIntervalMs());
+
+  // Pages held up by the display and restore setup aren't a render stall
+  renderScheduler.takeMaxLatenessMs();
+
+  // Network work on core 0; this (Arduino loop) task renders on core 1.
+  // TLS handshakes need a deep stack.
+  xTaskCreatePinnedToCore(networkTask, "network", 16384, nullptr, 1, nullptr,
+                          0);
+}
 
-  // Wait for display interval while maintaining IoT connection
-  unsigned long startTime = millis();
-  while (millis() - startTime < Config::getPageIntervalMs()) {
-    maintainAwsIotConnection();
-    delay(100); // Small delay to avoid tight loop
+void loop() {
+  // Run whatever render work is due, then sleep until the next deadline.
+  // Rendering never touches the heap, so a long-running device can't
+  // fragment it from this task.
+  uint32_t before = allocCount();
+  uint32_t idleMs = renderScheduler.runDue();
+  uint32_t made = allocationsSince(before);
+  if (made > 0) {
+    LOG_WARN("Render loop iteration: %lu heap allocations",
+             (unsigned long)made);
   }
+  delay(idleMs);
 }
@@ -0,0 +1,221 @@
+#include "metrics.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t LATENCY_BUCKETS_MS[8] = {10, 25, 50, 100, 250, 500, 1000, 2500};
+const uint32_t DURATION_BUCKETS_US[8] = {250,  500,   1000,  2000,
+                                         5000, 10000, 20000, 50000};
+const uint32_t SIZE_BUCKETS_BYTES[6] = {1024, 2048, 4096, 8192, 16384, 32768};
+
+Metrics metrics;
+
+static const uint32_t NO_LOW_WATER_MARK = 0xFFFFFFFF;
+
+int Metrics::addCounter(const char *name) {
+  if (counterCount == MAX_COUNTERS) {
+    return -1;
+  }
+
+  Counter &counter = counters[counterCount];
+  counter.name = name;
+  counter.value.store(0);
+  return counterCount++;
+}
+
+int Metrics::addHistogram(const char *name, const uint32_t *bounds,
+                          uint8_t boundCount) {
+  if (histogramCount == MAX_HISTOGRAMS || boundCount > MAX_BUCKETS) {
+    return -1;
+  }
+
+  Histogram &histogram = histograms[histogramCount];
+  histogram.name = name;
+  memcpy(histogram.bounds, bounds, boundCount * sizeof(uint32_t));
+  histogram.boundCount = boundCount;
+  for (int i = 0; i <= boundCount; i++) {
+    histogram.buckets[i].store(0);
+  }
+  histogram.sum.store(0);
+  histogram.max.store(0);
+  return histogramCount++;
+}
+
+int Metrics::addLowWaterMark(const char *name) {
+  if (lowWaterMarkCount == MAX_LOW_WATER_MARKS) {
+    return -1;
+  }
+
+  LowWaterMark &mark = lowWaterMarks[lowWaterMarkCount];
+  mark.name = name;
+  mark.low.store(NO_LOW_WATER_MARK);
+  return lowWaterMarkCount++;
+}
+
+void Metrics::increment(int counterId, uint32_t n) {
+  if (counterId < 0 || counterId >= counterCount) {
+    return;
+  }
+  counters[counterId].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+void Metrics::record(int histogramId, uint32_t value) {
+  if (histogramId < 0 || histogramId >= histogramCount) {
+    return;
+  }
+
+  Histogram &histogram = histograms[histogramId];
+  int bucket = 0;
+  while (bucket < histogram.boundCount && value > histogram.bounds[bucket]) {
+    bucket++;
+  }
+  histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  histogram.sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint32_t max = histogram.max.load(std::memory_order_relaxed);
+  while (value > max && !histogram.max.compare_exchange_weak(
+                            max, value, std::memory_order_relaxed)) {
+  }
+}
+
+void Metrics::recordLow(int lowWaterMarkId, uint32_t value) {
+  if (lowWaterMarkId < 0 || lowWaterMarkId >= lowWaterMarkCount) {
+    return;
+  }
+
+  std::atomic<uint32_t> &low = lowWaterMarks[lowWaterMarkId].low;
+  uint32_t seen = low.load(std::memory_order_relaxed);
+  while (value < seen &&
+         !low.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+  }
+}
+
+// Appends formatted text to a fixed buffer, remembering if anything didn't fit
+class ReportWriter {
+public:
+  ReportWriter(char *out, size_t size) : out(out), size(size) {}
+
+  void print(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    if (overflow) {
+      return;
+    }
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out + used, size - used, format, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - used) {
+      overflow = true;
+      return;
+    }
+    used += n;
+  }
+
+  size_t length() const { return overflow ? 0 : used; }
+
+private:
+  char *out;
+  size_t size;
+  size_t used = 0;
+  bool overflow = false;
+};
+
+size_t Metrics::report(char *out, size_t size, const char *fields) {
+  if (size == 0) {
+    return 0;
+  }
+
+  // Snapshot the period first. Only what was reported is subtracted
+  // afterwards, so a record racing with the report lands in the next period.
+  uint32_t counterValues[MAX_COUNTERS];
+  uint32_t bucketValues[MAX_HISTOGRAMS][MAX_BUCKETS + 1];
+  uint32_t sums[MAX_HISTOGRAMS];
+  uint32_t lows[MAX_LOW_WATER_MARKS];
+  for (int i = 0; i < counterCount; i++) {
+    counterValues[i] = counters[i].value.load(std::memory_order_relaxed);
+  }
+  for (int i = 0; i < histogramCount; i++) {
+    for (int b = 0; b <= histograms[i].boundCount; b++) {
+      bucketValues[i][b] =
+          histograms[i].buckets[b].load(std::memory_order_relaxed);
+    }
+    sums[i] = histograms[i].sum.load(std::memory_order_relaxed);
+  }
+  for (int i = 0; i < lowWaterMarkCount; i++) {
+    lows[i] = lowWaterMarks[i].low.load(std::memory_order_relaxed);
+  }
+
+  ReportWriter writer(out, size);
+  writer.print("{");
+  if (fields && fields[0]) {
+    writer.print("%s,", fields);
+  }
+
+  writer.print("\"counters\":{");
+  for (int i = 0; i < counterCount; i++) {
+    writer.print("%s\"%s\":%lu", i > 0 ? "," : "", counters[i].name,
+                 (unsigned long)counterValues[i]);
+  }
+
+  writer.print("},\"histograms\":{");
+  for (int i = 0; i < histogramCount; i++) {
+    const Histogram &histogram = histograms[i];
+    uint32_t n = 0;
+    for (int b = 0; b <= histogram.boundCount; b++) {
+      n += bucketValues[i][b];
+    }
+
+    writer.print("%s\"%s\":{\"n\":%lu", i > 0 ? "," : "", histogram.name,
+                 (unsigned long)n);
+    if (n > 0) {
+      writer.print(",\"sum\":%lu,\"max\":%lu,\"le\":[", (unsigned long)sums[i],
+                   (unsigned long)histogram.max.load(std::memory_order_relaxed));
+      for (int b = 0; b < histogram.boundCount; b++) {
+        writer.print("%s%lu", b > 0 ? "," : "",
+                     (unsigned long)histogram.bounds[b]);
+      }
+      writer.print("],\"b\":[");
+      for (int b = 0; b <= histogram.boundCount; b++) {
+        writer.print("%s%lu", b > 0 ? "," : "",
+                     (unsigned long)bucketValues[i][b]);
+      }
+      writer.print("]");
+    }
+    writer.print("}");
+  }
+
+  // Marks nothing was recorded for this period are left out
+  writer.print("},\"low_water\":{");
+  bool first = true;
+  for (int i = 0; i < lowWaterMarkCount; i++) {
+    if (lows[i] == NO_LOW_WATER_MARK) {
+      continue;
+    }
+    writer.print("%s\"%s\":%lu", first ? "" : ",", lowWaterMarks[i].name,
+                 (unsigned long)lows[i]);
+    first = false;
+  }
+  writer.print("}}");
+
+  size_t length = writer.length();
+  if (length == 0) {
+    return 0;
+  }
+
+  // Start the next period
+  for (int i = 0; i < counterCount; i++) {
+    counters[i].value.fetch_sub(counterValues[i], std::memory_order_relaxed);
+  }
+  for (int i = 0; i < histogramCount; i++) {
+    for (int b = 0; b <= histograms[i].boundCount; b++) {
+      histograms[i].buckets[b].fetch_sub(bucketValues[i][b],
+                                         std::memory_order_relaxed);
+    }
+    histograms[i].sum.fetch_sub(sums[i], std::memory_order_relaxed);
+    histograms[i].max.store(0, std::memory_order_relaxed);
+  }
+  for (int i = 0; i < lowWaterMarkCount; i++) {
+    lowWaterMarks[i].low.store(NO_LOW_WATER_MARK, std::memory_order_relaxed);
+  }
+
+  return length;
+}
@@ -0,0 +1,77 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Registry of counters, fixed-bucket histograms and low-water marks.
+// Metrics are registered once at startup and then recorded from any task
+// without locks or allocation. report() writes everything recorded since the
+// previous report as one compact JSON object and starts a new period.
+class Metrics {
+public:
+  static const int MAX_COUNTERS = 12;
+  static const int MAX_HISTOGRAMS = 12;
+  static const int MAX_LOW_WATER_MARKS = 4;
+  static const int MAX_BUCKETS = 8;
+
+  // Register a metric. Returns its id, or -1 if that kind is full.
+  // name must outlive the registry (a string literal).
+  int addCounter(const char *name);
+
+  // bounds are ascending inclusive upper bounds (at most MAX_BUCKETS); values
+  // above the last one go into an extra overflow bucket
+  int addHistogram(const char *name, const uint32_t *bounds,
+                   uint8_t boundCount);
+
+  int addLowWaterMark(const char *name);
+
+  // Record into metric id; an id of -1 (not registered) is ignored
+  void increment(int counterId, uint32_t n = 1);
+  void record(int histogramId, uint32_t value);
+  void recordLow(int lowWaterMarkId, uint32_t value);
+
+  // Write this period as {<fields>,"counters":{...},"histograms":{...},
+  // "low_water":{...}}, where fields (optional) are preformatted leading
+  // members. Histograms list their bounds as "le" and bucket counts as "b".
+  // Returns the length written, or 0 if it didn't fit (the period continues).
+  size_t report(char *out, size_t size, const char *fields = nullptr);
+
+private:
+  struct Counter {
+    const char *name;
+    std::atomic<uint32_t> value;
+  };
+
+  struct Histogram {
+    const char *name;
+    uint32_t bounds[MAX_BUCKETS];
+    uint8_t boundCount;
+    std::atomic<uint32_t> buckets[MAX_BUCKETS + 1];
+    std::atomic<uint32_t> sum;
+    std::atomic<uint32_t> max;
+  };
+
+  struct LowWaterMark {
+    const char *name;
+    std::atomic<uint32_t> low;
+  };
+
+  Counter counters[MAX_COUNTERS];
+  Histogram histograms[MAX_HISTOGRAMS];
+  LowWaterMark lowWaterMarks[MAX_LOW_WATER_MARKS];
+  int counterCount = 0;
+  int histogramCount = 0;
+  int lowWaterMarkCount = 0;
+};
+
+// Bucket bounds shared by the device metrics
+extern const uint32_t LATENCY_BUCKETS_MS[8];
+extern const uint32_t DURATION_BUCKETS_US[8];
+extern const uint32_t SIZE_BUCKETS_BYTES[6];
+
+// The registry the firmware records into
+extern Metrics metrics;
+
+#endif // METRICS_H
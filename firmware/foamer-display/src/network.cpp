@@ -0,0 +1,144 @@
+#include "network.h"
+#include "log.h"
+#include <Preferences.h>
+#include <string.h>
+
+// Directed connects associate in well under a second; give up quickly and
+// scan rather than waiting out an access point that has moved
+const uint32_t FAST_CONNECT_TIMEOUT_MS = 2000;
+const uint32_t SCAN_CONNECT_TIMEOUT_MS = 5000;
+
+const char *PREFS_NAMESPACE = "wifi";
+const char *PREFS_LINK_KEY = "link";
+
+// Last good association, stored as one NVS blob. The SSID is kept so a new
+// config profile doesn't try the old network's access point.
+struct CachedLink {
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip; // DHCP lease, reused as a static configuration on opt-in
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns1;
+  uint32_t dns2;
+};
+
+static WiFiConnectStats lastStats;
+
+const WiFiConnectStats &wifiConnectStats() { return lastStats; }
+
+static bool loadLink(const char *ssid, CachedLink &link) {
+  Preferences prefs;
+  if (!prefs.begin(PREFS_NAMESPACE, true)) {
+    return false;
+  }
+  bool found = prefs.getBytes(PREFS_LINK_KEY, &link, sizeof(link)) ==
+                   sizeof(link) &&
+               strncmp(link.ssid, ssid, sizeof(link.ssid)) == 0;
+  prefs.end();
+  return found;
+}
+
+// Only written when something changed, so a normal boot costs no flash wear
+static void saveLink(const CachedLink &link) {
+  Preferences prefs;
+  if (!prefs.begin(PREFS_NAMESPACE, false)) {
+    return;
+  }
+  CachedLink stored;
+  if (prefs.getBytes(PREFS_LINK_KEY, &stored, sizeof(stored)) !=
+          sizeof(stored) ||
+      memcmp(&stored, &link, sizeof(link)) != 0) {
+    prefs.putBytes(PREFS_LINK_KEY, &link, sizeof(link));
+  }
+  prefs.end();
+}
+
+static void forgetLink() {
+  Preferences prefs;
+  if (prefs.begin(PREFS_NAMESPACE, false)) {
+    prefs.remove(PREFS_LINK_KEY);
+    prefs.end();
+  }
+}
+
+// Wait until connected with an address, or the attempt has failed for good
+static bool waitForConnection(uint32_t timeoutMs) {
+  unsigned long startMs = millis();
+  while (millis() - startMs < timeoutMs) {
+    wl_status_t status = WiFi.status();
+    if (status == WL_CONNECTED) {
+      return true;
+    }
+    if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL) {
+      return false;
+    }
+    delay(20);
+  }
+  return false;
+}
+
+bool setupWiFi(const char *ssid, const char *password, bool reuseLease) {
+  LOG_INFO("Attempting to connect to SSID: %s", ssid);
+
+  // Our own cache replaces the driver's; don't rewrite its config on
+  // every begin()
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+
+  CachedLink link;
+  unsigned long startMs = millis();
+  if (loadLink(ssid, link)) {
+    // Without the opt-in DHCP still runs: another device may hold the
+    // address by now
+    bool staticLease = reuseLease && link.ip != 0;
+    if (staticLease) {
+      WiFi.config(IPAddress(link.ip), IPAddress(link.gateway),
+                  IPAddress(link.subnet), IPAddress(link.dns1),
+                  IPAddress(link.dns2));
+    }
+    WiFi.begin(ssid, password, link.channel, link.bssid);
+    if (waitForConnection(FAST_CONNECT_TIMEOUT_MS)) {
+      lastStats.fast = true;
+      lastStats.connectMs = millis() - startMs;
+      LOG_INFO("WiFi connected in %lums (cached AP, channel %u%s)",
+               (unsigned long)lastStats.connectMs, link.channel,
+               staticLease ? ", cached lease" : "");
+      return true;
+    }
+
+    // The access point or the lease is gone; scan and ask DHCP instead
+    LOG_WARN("WiFi cached AP failed after %lums, scanning",
+             millis() - startMs);
+    forgetLink();
+    WiFi.disconnect();
+    if (staticLease) {
+      WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    }
+  }
+
+  WiFi.begin(ssid, password);
+  if (!waitForConnection(SCAN_CONNECT_TIMEOUT_MS)) {
+    LOG_ERROR("WiFi connection failed after %lums", millis() - startMs);
+    WiFi.disconnect();
+    return false;
+  }
+
+  lastStats.fast = false;
+  lastStats.connectMs = millis() - startMs;
+  LOG_INFO("WiFi connected in %lums (scan, channel %d)",
+           (unsigned long)lastStats.connectMs, WiFi.channel());
+
+  memset(&link, 0, sizeof(link));
+  strncpy(link.ssid, ssid, sizeof(link.ssid) - 1);
+  memcpy(link.bssid, WiFi.BSSID(), sizeof(link.bssid));
+  link.channel = WiFi.channel();
+  link.ip = WiFi.localIP();
+  link.gateway = WiFi.gatewayIP();
+  link.subnet = WiFi.subnetMask();
+  link.dns1 = WiFi.dnsIP(0);
+  link.dns2 = WiFi.dnsIP(1);
+  saveLink(link);
+  return true;
+}
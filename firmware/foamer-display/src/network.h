@@ -5,36 +5,21 @@
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 
-// Initialize WiFi connection
-bool setupWiFi(const char *ssid, const char *password) {
-  Serial.print("Attempting to connect to SSID: ");
-  Serial.println(ssid);
-
-  WiFi.begin(ssid, password);
-
-  for (int i = 0; i < 10; i++) {
+// How the last setupWiFi() got on
+struct WiFiConnectStats {
+  bool fast;          // true if the cached access point was used
+  uint32_t connectMs; // WiFi.begin() until connected with an address
+};
 
-    if (WiFi.status() == WL_CONNECTED) {
-      Serial.println("");
-      Serial.println("Connected to WiFi");
-      return true;
-    }
-    Serial.print(".");
-    if (i < 9)
-      delay(500);
-  }
-  Serial.println("WiFi connection failed");
-  return false;
-}
-
-// Create and configure HTTP client for HTTPS URLs
-WiFiClientSecure *createSecureClient() {
-  WiFiClientSecure *client = new WiFiClientSecure();
-  client->setInsecure(); // Skip certificate verification for simplicity
-  return client;
-}
-
-// Create HTTP client for HTTP URLs
-WiFiClient *createClient() { return new WiFiClient(); }
+// Initialize WiFi connection
+// Tries a directed connect to the access point and channel cached in NVS by
+// the last successful connect, which skips the channel scan. With reuseLease
+// the cached DHCP lease is applied as a static configuration too, skipping
+// DHCP; only safe where the router reserves the address for the device. If
+// that fails (or nothing is cached) the cache is dropped and a full
+// scan-and-connect runs; its result is cached for next boot.
+bool setupWiFi(const char *ssid, const char *password, bool reuseLease);
+
+const WiFiConnectStats &wifiConnectStats();
 
 #endif // NETWORK_H
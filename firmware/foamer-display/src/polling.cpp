@@ -0,0 +1,101 @@
+#include "polling.h"
+
+// Weight of the newest outcome in the moving error rate
+static const float ERROR_RATE_WEIGHT = 0.2f;
+
+uint32_t PollingPolicy::onSuccess(const DepartureBoard &board,
+                                  uint32_t nowMs) {
+  recordOutcome(false);
+
+  // Find the soonest departure that hasn't left yet
+  haveDepartures = false;
+  hasRealtime = false;
+  int32_t soonestMs = 0;
+  for (int r = 0; r < board.routeCount; r++) {
+    const Route &route = board.routes[r];
+    for (int d = 0; d < route.directionCount; d++) {
+      const Direction &direction = route.directions[d];
+      for (int i = 0; i < direction.departureCount; i++) {
+        const Departure &dep = direction.departures[i];
+        int32_t untilMs = static_cast<int32_t>(dep.dueMs - nowMs);
+        if (untilMs < 0) {
+          continue;
+        }
+        if (!haveDepartures || untilMs < soonestMs) {
+          soonestMs = untilMs;
+        }
+        haveDepartures = true;
+        hasRealtime = hasRealtime || dep.realtime;
+      }
+    }
+  }
+  soonestDueMs = nowMs + soonestMs;
+
+  return healthyDelay(nowMs);
+}
+
+uint32_t PollingPolicy::onNotModified(uint32_t nowMs) {
+  recordOutcome(false);
+  return healthyDelay(nowMs);
+}
+
+uint32_t PollingPolicy::onFailure() {
+  recordOutcome(true);
+
+  // retryMs, 2x, 4x, ... up to backoffMaxMs
+  uint32_t delayMs = bounds.retryMs;
+  for (int i = 1; i < consecutiveFailures && delayMs < bounds.backoffMaxMs;
+       i++) {
+    delayMs *= 2;
+  }
+  if (delayMs > bounds.backoffMaxMs) {
+    delayMs = bounds.backoffMaxMs;
+  }
+
+  // Spread retries over the upper half of the window ("equal jitter")
+  return delayMs / 2 + jitter(0, delayMs / 2);
+}
+
+uint32_t PollingPolicy::healthyDelay(uint32_t nowMs) {
+  uint32_t delayMs = bounds.maxMs;
+
+  // Refresh halfway to the soonest departure so it's re-predicted before it
+  // leaves. Counting down locally covers the time in between. Once it has
+  // left (304s since) the board is running out, so refresh as soon as
+  // allowed.
+  if (haveDepartures) {
+    int32_t untilMs = static_cast<int32_t>(soonestDueMs - nowMs);
+    if (untilMs <= 0) {
+      delayMs = bounds.minMs;
+    } else if (static_cast<uint32_t>(untilMs / 2) < delayMs) {
+      delayMs = untilMs / 2;
+    }
+  }
+
+  // Real-time predictions move, scheduled times don't
+  if (hasRealtime && bounds.realtimeMs < delayMs) {
+    delayMs = bounds.realtimeMs;
+  }
+
+  // Back off while the server has been unreliable lately
+  delayMs += static_cast<uint32_t>(delayMs * 2 * recentErrorRate);
+
+  // +/-10% so devices drift apart instead of polling in lockstep
+  delayMs = jitter(delayMs - delayMs / 10, delayMs / 5);
+
+  return delayMs < bounds.minMs ? bounds.minMs : delayMs;
+}
+
+void PollingPolicy::recordOutcome(bool failed) {
+  consecutiveFailures = failed ? consecutiveFailures + 1 : 0;
+  recentErrorRate += ERROR_RATE_WEIGHT * ((failed ? 1.0f : 0.0f) -
+                                          recentErrorRate);
+}
+
+// delayMs plus a random amount in [0, spreadMs]
+uint32_t PollingPolicy::jitter(uint32_t delayMs, uint32_t spreadMs) {
+  if (spreadMs == 0) {
+    return delayMs;
+  }
+  return delayMs + random() % (spreadMs + 1);
+}
@@ -0,0 +1,57 @@
+#ifndef POLLING_H
+#define POLLING_H
+
+#include "departures.h"
+#include <stdint.h>
+
+// Bounds for the polling policy, from the config's polling section
+struct PollingBounds {
+  uint32_t minMs;        // Never poll more often than this
+  uint32_t maxMs;        // Never wait longer than this while healthy
+  uint32_t realtimeMs;   // Cap while real-time predictions are shown
+  uint32_t retryMs;      // First retry after a failure
+  uint32_t backoffMaxMs; // Cap on the retry backoff
+};
+
+// Returns a uniformly distributed 32-bit random number
+typedef uint32_t (*RandomFn)();
+
+// Decides when to fetch departures next.
+// While healthy the interval follows the data: poll again before the soonest
+// departure leaves, sooner when real-time predictions are on the board, and
+// stretch out as the recent error rate rises. After failures it backs off
+// exponentially. Every delay is jittered so a fleet that failed together
+// doesn't retry together.
+class PollingPolicy {
+public:
+  PollingPolicy(const PollingBounds &bounds, RandomFn random)
+      : bounds(bounds), random(random) {}
+
+  // Delay until the next fetch after new data was decoded into board
+  uint32_t onSuccess(const DepartureBoard &board, uint32_t nowMs);
+
+  // Delay after a 304: the data from the last onSuccess() still holds. If
+  // its soonest departure has left by now, the delay drops to minMs.
+  uint32_t onNotModified(uint32_t nowMs);
+
+  // Delay after a failed fetch
+  uint32_t onFailure();
+
+  // Share of recent fetches that failed, 0..1
+  float errorRate() const { return recentErrorRate; }
+
+private:
+  uint32_t healthyDelay(uint32_t nowMs);
+  void recordOutcome(bool failed);
+  uint32_t jitter(uint32_t delayMs, uint32_t spreadMs);
+
+  PollingBounds bounds;
+  RandomFn random;
+  bool haveDepartures = false;
+  uint32_t soonestDueMs = 0; // millis() the soonest departure leaves
+  bool hasRealtime = false;
+  int consecutiveFailures = 0;
+  float recentErrorRate = 0;
+};
+
+#endif // POLLING_H
@@ -0,0 +1,64 @@
+#include "reconnect.h"
+
+Reconnector::Action Reconnector::next(uint32_t nowMs) const {
+  switch (state) {
+  case CONNECTED:
+    return SERVICE;
+  case TRANSPORT_UP:
+    return CONNECT_SESSION;
+  case DISCONNECTED:
+  default:
+    if (waiting && static_cast<int32_t>(retryAtMs - nowMs) > 0) {
+      return WAIT;
+    }
+    return CONNECT_TRANSPORT;
+  }
+}
+
+void Reconnector::onTransport(bool ok, uint32_t nowMs) {
+  attemptCount++;
+  if (ok) {
+    state = TRANSPORT_UP;
+  } else {
+    fail(nowMs);
+  }
+}
+
+void Reconnector::onSession(bool ok, uint32_t nowMs) {
+  if (ok) {
+    state = CONNECTED;
+    failures = 0;
+    waiting = false;
+  } else {
+    fail(nowMs);
+  }
+}
+
+void Reconnector::onLost() {
+  state = DISCONNECTED;
+  waiting = false;
+}
+
+void Reconnector::fail(uint32_t nowMs) {
+  state = DISCONNECTED;
+  failures++;
+
+  // retryMs, 2x, 4x, ... up to maxMs
+  uint32_t delayMs = bounds.retryMs;
+  for (int i = 1; i < failures && delayMs < bounds.maxMs; i++) {
+    delayMs *= 2;
+  }
+  if (delayMs > bounds.maxMs) {
+    delayMs = bounds.maxMs;
+  }
+
+  // Spread retries over the upper half of the window ("equal jitter")
+  uint32_t spreadMs = delayMs / 2;
+  delayMs -= spreadMs;
+  if (spreadMs > 0) {
+    delayMs += random() % (spreadMs + 1);
+  }
+
+  retryAtMs = nowMs + delayMs;
+  waiting = true;
+}
@@ -0,0 +1,60 @@
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include "polling.h" // RandomFn
+#include <stdint.h>
+
+// Retry timing after failed connection attempts
+struct BackoffBounds {
+  uint32_t retryMs; // Delay after the first failure
+  uint32_t maxMs;   // Cap on the backoff
+};
+
+// Drives a connection that is made in two blocking steps, transport (TCP and
+// TLS) then session (e.g. MQTT CONNECT), so a caller polling it never spends
+// more than one step at a time. Failed attempts back off exponentially with
+// jitter; a lost connection is retried right away once.
+class Reconnector {
+public:
+  enum Action : uint8_t {
+    WAIT,              // Nothing to do until the backoff has passed
+    CONNECT_TRANSPORT, // Open the transport, report with onTransport()
+    CONNECT_SESSION,   // Open the session, report with onSession()
+    SERVICE,           // Connected: service it, report a drop with onLost()
+  };
+
+  Reconnector(const BackoffBounds &bounds, RandomFn random)
+      : bounds(bounds), random(random) {}
+
+  // What to do at nowMs
+  Action next(uint32_t nowMs) const;
+
+  // Outcome of CONNECT_TRANSPORT, and of CONNECT_SESSION. Either failing
+  // ends the attempt and starts the backoff.
+  void onTransport(bool ok, uint32_t nowMs);
+  void onSession(bool ok, uint32_t nowMs);
+
+  // The connection dropped while in SERVICE
+  void onLost();
+
+  bool connected() const { return state == CONNECTED; }
+
+  // Attempts started (transport steps), and failures since the last success
+  uint32_t attempts() const { return attemptCount; }
+  int consecutiveFailures() const { return failures; }
+
+private:
+  enum State : uint8_t { DISCONNECTED, TRANSPORT_UP, CONNECTED };
+
+  void fail(uint32_t nowMs);
+
+  BackoffBounds bounds;
+  RandomFn random;
+  State state = DISCONNECTED;
+  uint32_t retryAtMs = 0;
+  bool waiting = false; // retryAtMs is in force
+  uint32_t attemptCount = 0;
+  int failures = 0;
+};
+
+#endif // RECONNECT_H
@@ -0,0 +1,37 @@
+#include "renderer.h"
+#include "frame.h"
+
+Renderer::Renderer(MatrixPanel_I2S_DMA *panel)
+    : GFXcanvas16(PANEL_WIDTH, PANEL_HEIGHT), panel(panel),
+      textRenderer(glyphs, getBuffer(), PANEL_WIDTH, PANEL_HEIGHT) {}
+
+Renderer::~Renderer() { free(shown); }
+
+bool Renderer::begin() {
+  // The panel starts out black, which is all zeros in RGB565
+  shown = static_cast<uint16_t *>(calloc(WIDTH * HEIGHT, sizeof(uint16_t)));
+
+  // Rasterize every glyph through GFX's own drawChar, so the text renderer
+  // draws exactly the pixels print() would
+  GFXcanvas1 cell(TextRenderer::CELL_WIDTH, TextRenderer::CELL_HEIGHT);
+  for (int c = 0; c < 256; c++) {
+    cell.fillScreen(0);
+    cell.drawChar(0, 0, c, 1, 0, 1);
+    for (int y = 0; y < TextRenderer::CELL_HEIGHT; y++) {
+      uint8_t bits = 0;
+      for (int x = 0; x < TextRenderer::CELL_WIDTH; x++) {
+        if (cell.getPixel(x, y)) {
+          bits |= 1 << x;
+        }
+      }
+      glyphs[c][y] = bits;
+    }
+  }
+
+  return shown && getBuffer() && cell.getBuffer();
+}
+
+void Renderer::present() {
+  lastWritten = presentChanges(getBuffer(), shown, WIDTH, HEIGHT, *panel);
+  totalWritten += lastWritten;
+}
@@ -0,0 +1,48 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "asset.h"
+#include "display.h"
+#include "text.h"
+#include <Adafruit_GFX.h>
+
+// Off-screen frame for the LED panel.
+// Draw the next frame with the usual Adafruit GFX calls (fillScreen, print,
+// ...), then present() it: only pixels that differ from what the panel shows
+// are pushed through the DMA driver, so redrawing an unchanged page writes
+// nothing and there is no visible clear between frames.
+class Renderer : public GFXcanvas16 {
+public:
+  explicit Renderer(MatrixPanel_I2S_DMA *panel);
+  ~Renderer();
+
+  // Allocate the frame buffers and rasterize the font, returns false if out
+  // of memory
+  bool begin();
+
+  // Fast text for the board pages, pixel for pixel what print() draws with
+  // the default font at size 1 and wrapping off. Has its own cursor.
+  TextRenderer &text() { return textRenderer; }
+
+  // Decode a compressed asset straight into the frame, clipped to it
+  void drawAsset(const Asset &asset, int16_t x, int16_t y) {
+    blitAsset(asset, getBuffer(), WIDTH, HEIGHT, x, y);
+  }
+
+  // Write the changed pixels of this frame to the panel
+  void present();
+
+  // Pixels written to the panel by the last present(), and overall
+  uint32_t lastPixelsWritten() const { return lastWritten; }
+  uint32_t totalPixelsWritten() const { return totalWritten; }
+
+private:
+  MatrixPanel_I2S_DMA *panel;
+  uint16_t *shown = nullptr; // Copy of what the panel currently displays
+  TextRenderer::Glyph glyphs[256];
+  TextRenderer textRenderer;
+  uint32_t lastWritten = 0;
+  uint32_t totalWritten = 0;
+};
+
+#endif // RENDERER_H
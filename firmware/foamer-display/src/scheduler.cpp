@@ -0,0 +1,92 @@
+#include "scheduler.h"
+
+// Deadlines are compared through a signed difference so they keep working
+// when the 32-bit millisecond clock wraps (every ~49 days)
+static int32_t msUntil(uint32_t dueMs, uint32_t nowMs) {
+  return static_cast<int32_t>(dueMs - nowMs);
+}
+
+int Scheduler::add(const char *name, JobFn fn, uint32_t periodMs,
+                   uint32_t delayMs) {
+  if (jobCount == MAX_JOBS) {
+    return -1;
+  }
+
+  Job &job = jobs[jobCount];
+  job.name = name;
+  job.fn = fn;
+  job.periodMs = periodMs;
+  job.dueMs = clock() + delayMs;
+  job.active = delayMs != NEVER;
+  return jobCount++;
+}
+
+void Scheduler::schedule(int id, uint32_t delayMs) {
+  if (id < 0 || id >= jobCount) {
+    return;
+  }
+  jobs[id].dueMs = clock() + delayMs;
+  jobs[id].active = true;
+}
+
+void Scheduler::cancel(int id) {
+  if (id < 0 || id >= jobCount) {
+    return;
+  }
+  jobs[id].active = false;
+}
+
+bool Scheduler::isScheduled(int id) const {
+  return id >= 0 && id < jobCount && jobs[id].active;
+}
+
+uint32_t Scheduler::takeMaxLatenessMs() {
+  uint32_t latenessMs = maxLatenessMs;
+  maxLatenessMs = 0;
+  return latenessMs;
+}
+
+uint32_t Scheduler::runDue(uint32_t maxIdleMs) {
+  for (int i = 0; i < jobCount; i++) {
+    Job &job = jobs[i];
+    uint32_t nowMs = clock();
+    if (!job.active || msUntil(job.dueMs, nowMs) > 0) {
+      continue;
+    }
+
+    uint32_t latenessMs = nowMs - job.dueMs;
+    if (latenessMs > maxLatenessMs) {
+      maxLatenessMs = latenessMs;
+    }
+
+    // Set the next deadline before running so the job can override it
+    if (job.periodMs > 0) {
+      job.dueMs += job.periodMs;
+      // Skip missed periods rather than running back to back to catch up
+      if (msUntil(job.dueMs, nowMs) <= 0) {
+        job.dueMs = nowMs + job.periodMs;
+      }
+    } else {
+      job.active = false;
+    }
+
+    job.fn();
+  }
+
+  // Time until the earliest remaining deadline
+  uint32_t nowMs = clock();
+  uint32_t idleMs = maxIdleMs;
+  for (int i = 0; i < jobCount; i++) {
+    if (!jobs[i].active) {
+      continue;
+    }
+    int32_t untilMs = msUntil(jobs[i].dueMs, nowMs);
+    if (untilMs <= 0) {
+      return 0;
+    }
+    if (static_cast<uint32_t>(untilMs) < idleMs) {
+      idleMs = untilMs;
+    }
+  }
+  return idleMs;
+}
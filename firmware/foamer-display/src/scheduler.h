@@ -0,0 +1,61 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Millisecond clock, millis() on the device and a fake clock in tests
+typedef uint32_t (*ClockFn)();
+typedef void (*JobFn)();
+
+// Cooperative scheduler for timed jobs.
+// Each job has a deadline; runDue() runs the ones that are due and reports
+// how long the caller may sleep. Jobs never block waiting for their next
+// turn, they reschedule themselves instead.
+class Scheduler {
+public:
+  static const int MAX_JOBS = 8;
+  static const uint32_t NEVER = 0xFFFFFFFF;
+
+  explicit Scheduler(ClockFn clock) : clock(clock) {}
+
+  // Register a job. periodMs > 0 makes it repeat; with 0 it runs once per
+  // schedule() call. The first run is delayMs from now, or only once
+  // scheduled if delayMs is NEVER. Returns the job id, or -1 if full.
+  int add(const char *name, JobFn fn, uint32_t periodMs,
+          uint32_t delayMs = 0);
+
+  // Run job id delayMs from now, replacing its current deadline.
+  // Safe to call from inside a running job, including on itself.
+  void schedule(int id, uint32_t delayMs);
+
+  // Stop job id from running until it is scheduled again
+  void cancel(int id);
+
+  bool isScheduled(int id) const;
+
+  // Run every job whose deadline has passed, once each.
+  // Returns ms until the next deadline, capped at maxIdleMs.
+  uint32_t runDue(uint32_t maxIdleMs = 1000);
+
+  uint32_t now() const { return clock(); }
+
+  // Largest delay between a deadline and its job starting since the last
+  // call, i.e. how long the longest stall held other jobs up
+  uint32_t takeMaxLatenessMs();
+
+private:
+  struct Job {
+    const char *name;
+    JobFn fn;
+    uint32_t periodMs;
+    uint32_t dueMs;
+    bool active;
+  };
+
+  ClockFn clock;
+  Job jobs[MAX_JOBS];
+  int jobCount = 0;
+  uint32_t maxLatenessMs = 0;
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,190 @@
+#include "snapshot_store.h"
+#include <string.h>
+
+// Layout, little-endian:
+//   'D' version u32:savedEpoch u32:fetchedEpoch u8:routeCount
+//   per route: str:header u16:color u8:directionCount
+//     per direction: str:headsign u8:departureCount
+//       per departure: i32:dueMs relative to saving, u8:realtime
+//   u8:messageLineCount str:line...
+// where str is a length byte followed by the characters.
+static const uint8_t SNAPSHOT_MAGIC = 'D';
+static const uint8_t SNAPSHOT_VERSION = 1;
+
+// Anything before 2001 means the clock was never set
+static const uint32_t MIN_VALID_EPOCH = 1000000000;
+
+namespace {
+
+class Writer {
+public:
+  Writer(uint8_t *out, size_t size) : out(out), size(size) {}
+
+  void put8(uint8_t value) {
+    if (used < size) {
+      out[used] = value;
+    }
+    used++;
+  }
+
+  void put16(uint16_t value) {
+    put8(value);
+    put8(value >> 8);
+  }
+
+  void put32(uint32_t value) {
+    put16(value);
+    put16(value >> 16);
+  }
+
+  void putString(const char *value, size_t maxLength) {
+    size_t length = strnlen(value, maxLength);
+    put8(length);
+    for (size_t i = 0; i < length; i++) {
+      put8(value[i]);
+    }
+  }
+
+  // Bytes written, 0 if they didn't fit
+  size_t length() const { return used <= size ? used : 0; }
+
+private:
+  uint8_t *out;
+  size_t size;
+  size_t used = 0;
+};
+
+class Reader {
+public:
+  Reader(const uint8_t *data, size_t length) : data(data), length(length) {}
+
+  uint8_t get8() {
+    if (used >= length) {
+      ok = false;
+      return 0;
+    }
+    return data[used++];
+  }
+
+  uint16_t get16() {
+    uint16_t low = get8();
+    return low | (get8() << 8);
+  }
+
+  uint32_t get32() {
+    uint32_t low = get16();
+    return low | ((uint32_t)get16() << 16);
+  }
+
+  // Read a string into dest (maxLength + 1 bytes), failing if it's longer
+  void getString(char *dest, size_t maxLength) {
+    size_t n = get8();
+    if (n > maxLength) {
+      ok = false;
+      n = 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+      dest[i] = get8();
+    }
+    dest[n] = '\0';
+  }
+
+  // Read a count, failing if it's over max
+  uint8_t getCount(int max) {
+    uint8_t count = get8();
+    if (count > max) {
+      ok = false;
+      return 0;
+    }
+    return count;
+  }
+
+  bool ok = true;
+
+private:
+  const uint8_t *data;
+  size_t length;
+  size_t used = 0;
+};
+
+} // namespace
+
+size_t encodeSnapshot(const DepartureBoard &board, uint32_t nowMs,
+                      uint32_t nowEpoch, uint8_t *out, size_t size) {
+  Writer writer(out, size);
+  writer.put8(SNAPSHOT_MAGIC);
+  writer.put8(SNAPSHOT_VERSION);
+  writer.put32(nowEpoch >= MIN_VALID_EPOCH ? nowEpoch : 0);
+  writer.put32(board.fetchedEpoch);
+
+  writer.put8(board.routeCount);
+  for (int r = 0; r < board.routeCount; r++) {
+    const Route &route = board.routes[r];
+    writer.putString(route.header, LINE_CHARS);
+    writer.put16(route.color);
+    writer.put8(route.directionCount);
+    for (int d = 0; d < route.directionCount; d++) {
+      const Direction &direction = route.directions[d];
+      writer.putString(direction.headsign, HEADSIGN_WIDTH);
+      writer.put8(direction.departureCount);
+      for (int i = 0; i < direction.departureCount; i++) {
+        const Departure &departure = direction.departures[i];
+        writer.put32(departure.dueMs - nowMs);
+        writer.put8(departure.realtime);
+      }
+    }
+  }
+
+  writer.put8(board.messageLineCount);
+  for (int i = 0; i < board.messageLineCount; i++) {
+    writer.putString(board.message[i], LINE_CHARS);
+  }
+  return writer.length();
+}
+
+bool decodeSnapshot(const uint8_t *data, size_t length, DepartureBoard &board,
+                    uint32_t nowMs, uint32_t nowEpoch) {
+  Reader reader(data, length);
+  if (reader.get8() != SNAPSHOT_MAGIC || reader.get8() != SNAPSHOT_VERSION) {
+    return false;
+  }
+
+  uint32_t savedEpoch = reader.get32();
+  uint32_t ageMs = 0;
+  if (savedEpoch >= MIN_VALID_EPOCH && nowEpoch >= savedEpoch) {
+    ageMs = (nowEpoch - savedEpoch) * 1000;
+  }
+  board.fetchedEpoch = reader.get32();
+
+  board.routeCount = reader.getCount(MAX_ROUTES);
+  for (int r = 0; r < board.routeCount && reader.ok; r++) {
+    Route &route = board.routes[r];
+    reader.getString(route.header, LINE_CHARS);
+    route.color = reader.get16();
+    route.directionCount = reader.getCount(MAX_DIRECTIONS);
+    for (int d = 0; d < route.directionCount; d++) {
+      Direction &direction = route.directions[d];
+      reader.getString(direction.headsign, HEADSIGN_WIDTH);
+      direction.departureCount = reader.getCount(MAX_STORED_DEPARTURES);
+      for (int i = 0; i < direction.departureCount; i++) {
+        Departure &departure = direction.departures[i];
+        departure.dueMs = nowMs + reader.get32() - ageMs;
+        departure.realtime = reader.get8() != 0;
+      }
+    }
+  }
+
+  board.messageLineCount = reader.getCount(MAX_MESSAGE_LINES);
+  for (int i = 0; i < board.messageLineCount; i++) {
+    reader.getString(board.message[i], LINE_CHARS);
+  }
+  return reader.ok;
+}
+
+uint32_t snapshotEpoch(const uint8_t *data, size_t length) {
+  Reader reader(data, length);
+  if (reader.get8() != SNAPSHOT_MAGIC || reader.get8() != SNAPSHOT_VERSION) {
+    return 0;
+  }
+  return reader.get32();
+}
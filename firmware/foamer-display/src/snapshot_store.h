@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_STORE_H
+#define SNAPSHOT_STORE_H
+
+#include "departures.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact binary form of a DepartureBoard, kept in flash so the last known
+// departures can be shown right after a reboot. Only the routes, directions,
+// departures and message lines in use are written; strings are length
+// prefixed and departure times are stored relative to when it was encoded.
+
+// Largest encoding of a full board
+const size_t SNAPSHOT_MAX_BYTES =
+    11 + MAX_ROUTES * (1 + LINE_CHARS + 3 +
+                       MAX_DIRECTIONS * (1 + HEADSIGN_WIDTH + 1 +
+                                         MAX_STORED_DEPARTURES * 5)) +
+    1 + MAX_MESSAGE_LINES * (1 + LINE_CHARS);
+
+// Encode board as it stands at nowMs (millis()), nowEpoch being the unix
+// time then (0 if unknown). Returns the bytes written to out, 0 if it didn't
+// fit.
+size_t encodeSnapshot(const DepartureBoard &board, uint32_t nowMs,
+                      uint32_t nowEpoch, uint8_t *out, size_t size);
+
+// Decode a snapshot into board, anchoring departures to nowMs. If the unix
+// time is known both now and when it was encoded, departures are aged by the
+// time in between; otherwise they count down from where they were. Returns
+// false, with board undefined, if data isn't a valid snapshot.
+bool decodeSnapshot(const uint8_t *data, size_t length, DepartureBoard &board,
+                    uint32_t nowMs, uint32_t nowEpoch);
+
+// Unix time a snapshot was encoded at, 0 if unknown or not a snapshot
+uint32_t snapshotEpoch(const uint8_t *data, size_t length);
+
+#endif // SNAPSHOT_STORE_H
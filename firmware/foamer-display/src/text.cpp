@@ -0,0 +1,67 @@
+#include "text.h"
+
+void TextRenderer::print(const char *text, uint16_t color) {
+  while (*text) {
+    int length = 0;
+    while (text[length] && text[length] != '\n' && text[length] != '\r') {
+      length++;
+    }
+    drawRun(text, length, color);
+    text += length;
+
+    // GFX ignores carriage returns
+    if (*text == '\n') {
+      newline();
+    }
+    if (*text) {
+      text++;
+    }
+  }
+}
+
+void TextRenderer::print(int value, uint16_t color) {
+  char digits[12];
+  char *start = digits + sizeof(digits) - 1;
+  *start = '\0';
+  unsigned int magnitude = value < 0 ? 0u - value : value;
+  do {
+    *--start = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0) {
+    *--start = '-';
+  }
+  drawRun(start, digits + sizeof(digits) - 1 - start, color);
+}
+
+void TextRenderer::drawRun(const char *text, int length, uint16_t color) {
+  int16_t runX = cursorX;
+  cursorX += length * CELL_WIDTH;
+
+  for (int row = 0; row < CELL_HEIGHT; row++) {
+    int y = cursorY + row;
+    if (y < 0 || y >= height) {
+      continue;
+    }
+    uint16_t *line = buffer + y * width;
+
+    int x = runX;
+    for (int i = 0; i < length && x < width; i++, x += CELL_WIDTH) {
+      uint8_t bits = glyphs[(uint8_t)text[i]][row];
+      if (x >= 0 && x + CELL_WIDTH <= width) {
+        // Whole cell inside the frame, the common case
+        for (uint16_t *pixel = line + x; bits; bits >>= 1, pixel++) {
+          if (bits & 1) {
+            *pixel = color;
+          }
+        }
+      } else {
+        for (int column = x; bits; bits >>= 1, column++) {
+          if ((bits & 1) && column >= 0 && column < width) {
+            line[column] = color;
+          }
+        }
+      }
+    }
+  }
+}
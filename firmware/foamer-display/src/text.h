@@ -0,0 +1,51 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdint.h>
+
+// Text for the board's fixed character grid, drawn the way Adafruit GFX
+// print() draws the classic 5x7 font at size 1 with wrapping off: 6x8 cells,
+// transparent background, '\n' moves to the start of the next line and
+// characters past the edge are clipped. The same pixels, but each glyph is
+// a prebuilt bitmask per row and a string is drawn row by row in one color,
+// instead of a writePixel() call per font pixel.
+class TextRenderer {
+public:
+  static const int CELL_WIDTH = 6;
+  static const int CELL_HEIGHT = 8;
+
+  // One glyph: a bitmask per row, bit 0 is the leftmost column
+  typedef uint8_t Glyph[CELL_HEIGHT];
+
+  // glyphs holds all 256 character codes; buffer is the RGB565 frame
+  TextRenderer(const Glyph *glyphs, uint16_t *buffer, int16_t width,
+               int16_t height)
+      : glyphs(glyphs), buffer(buffer), width(width), height(height) {}
+
+  void setCursor(int16_t x, int16_t y) {
+    cursorX = x;
+    cursorY = y;
+  }
+  int16_t getCursorX() const { return cursorX; }
+  int16_t getCursorY() const { return cursorY; }
+
+  void print(const char *text, uint16_t color);
+  void print(int value, uint16_t color);
+  void newline() {
+    cursorX = 0;
+    cursorY += CELL_HEIGHT;
+  }
+
+private:
+  // Draw a run of characters without line breaks at the cursor
+  void drawRun(const char *text, int length, uint16_t color);
+
+  const Glyph *glyphs;
+  uint16_t *buffer;
+  int16_t width;
+  int16_t height;
+  int16_t cursorX = 0;
+  int16_t cursorY = 0;
+};
+
+#endif // TEXT_H
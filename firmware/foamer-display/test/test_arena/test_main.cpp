@@ -0,0 +1,127 @@
+// Bump arena allocator, on its own and under a JsonDocument
+
+#include "arena.h"
+#include "departures.h"
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <unity.h>
+
+static std::string readFixture(const char *name) {
+  std::ifstream file(std::string(NOTES_STATIC_DIR) + "/" + name);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_allocates_aligned_until_full() {
+  alignas(8) static char buffer[100];
+  ArenaAllocator arena;
+  arena.begin(buffer + 1, sizeof(buffer) - 1); // Misaligned on purpose
+
+  void *a = arena.allocate(3);
+  void *b = arena.allocate(20);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_NOT_NULL(b);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)a % 8);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)b % 8);
+  TEST_ASSERT_TRUE((char *)b >= (char *)a + 3);
+  TEST_ASSERT_EQUAL(8 + 8 + 8 + 24, arena.used());
+
+  // 48 of 92 usable bytes used, the next 48 byte block doesn't fit
+  TEST_ASSERT_NULL(arena.allocate(40));
+  TEST_ASSERT_NOT_NULL(arena.allocate(32));
+
+  arena.reset();
+  TEST_ASSERT_EQUAL(0, arena.used());
+  TEST_ASSERT_EQUAL(a, arena.allocate(3));
+}
+
+void test_most_recent_block_resizes_in_place() {
+  static char buffer[256];
+  ArenaAllocator arena;
+  arena.begin(buffer, sizeof(buffer));
+
+  char *old = static_cast<char *>(arena.allocate(8));
+  memcpy(old, "12345678", 8);
+  char *recent = static_cast<char *>(arena.allocate(8));
+
+  // Growing the last block keeps it where it is
+  TEST_ASSERT_EQUAL(recent, arena.reallocate(recent, 64));
+  TEST_ASSERT_EQUAL(16 + 8 + 64, arena.used());
+  TEST_ASSERT_EQUAL(recent, arena.reallocate(recent, 4));
+  TEST_ASSERT_EQUAL(16 + 16, arena.used());
+
+  // Freeing it gives the space back
+  arena.deallocate(recent);
+  TEST_ASSERT_EQUAL(16, arena.used());
+
+  // An older block moves when it grows, with its contents
+  arena.allocate(8);
+  char *moved = static_cast<char *>(arena.reallocate(old, 16));
+  TEST_ASSERT_NOT_NULL(moved);
+  TEST_ASSERT_TRUE(moved != old);
+  TEST_ASSERT_EQUAL(0, memcmp(moved, "12345678", 8));
+
+  // Older blocks are only freed by reset()
+  size_t used = arena.used();
+  arena.deallocate(old);
+  TEST_ASSERT_EQUAL(used, arena.used());
+
+  // The last block can't grow past the end
+  TEST_ASSERT_NULL(arena.reallocate(moved, 1024));
+}
+
+void test_without_buffer_uses_heap() {
+  ArenaAllocator arena;
+  TEST_ASSERT_FALSE(arena.hasBuffer());
+  void *p = arena.allocate(1000);
+  TEST_ASSERT_NOT_NULL(p);
+  p = arena.reallocate(p, 100000);
+  TEST_ASSERT_NOT_NULL(p);
+  arena.deallocate(p);
+  TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+// The departures document parses the same out of the arena, and running
+// out of arena is a parse error rather than a crash
+void test_json_document_in_arena() {
+  std::string payload = readFixture("foamer-example.json");
+  static char buffer[64 * 1024];
+  ArenaAllocator arena;
+  arena.begin(buffer, sizeof(buffer));
+
+  for (int fetch = 0; fetch < 3; fetch++) {
+    arena.reset();
+    JsonDocument doc(&arena);
+    TEST_ASSERT_FALSE(parseDepartures(payload, doc));
+
+    JsonDocument heapDoc;
+    TEST_ASSERT_FALSE(parseDepartures(payload, heapDoc));
+    std::string fromArena;
+    std::string fromHeap;
+    serializeJson(doc, fromArena);
+    serializeJson(heapDoc, fromHeap);
+    TEST_ASSERT_EQUAL_STRING(fromHeap.c_str(), fromArena.c_str());
+    TEST_ASSERT_GREATER_THAN(0, arena.used());
+  }
+
+  ArenaAllocator small;
+  small.begin(buffer, 256);
+  JsonDocument doc(&small);
+  TEST_ASSERT_TRUE(parseDepartures(payload, doc) ==
+                   DeserializationError::NoMemory);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_allocates_aligned_until_full);
+  RUN_TEST(test_most_recent_block_resizes_in_place);
+  RUN_TEST(test_without_buffer_uses_heap);
+  RUN_TEST(test_json_document_in_arena);
+  return UNITY_END();
+}
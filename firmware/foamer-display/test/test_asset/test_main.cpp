@@ -0,0 +1,160 @@
+// Decoding of compressed assets into a frame buffer, including clipping, and
+// the blit time against per-pixel writes of a raw bitmap
+
+#include "asset.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+static const uint16_t PALETTE[] = {0x0000, 0xF800, 0x07E0};
+
+// 4x3:
+//   R R G G
+//   . . . .
+//   G R R R
+static const uint8_t RUNS[] = {
+    2, 1, 2, 2, //
+    4, 0,       //
+    1, 2, 3, 1, //
+};
+static const Asset ASSET = {4, 3, PALETTE, RUNS};
+
+static const uint16_t EMPTY = 0x1234;
+static const uint16_t R = 0xF800;
+static const uint16_t G = 0x07E0;
+static const uint16_t K = 0x0000;
+
+static void fill(uint16_t *buffer, int n) {
+  for (int i = 0; i < n; i++) {
+    buffer[i] = EMPTY;
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_decodes_rows_in_place() {
+  uint16_t buffer[6 * 5];
+  fill(buffer, 6 * 5);
+  blitAsset(ASSET, buffer, 6, 5, 1, 1);
+
+  const uint16_t E = EMPTY;
+  const uint16_t want[6 * 5] = {
+      E, E, E, E, E, E, //
+      E, R, R, G, G, E, //
+      E, K, K, K, K, E, //
+      E, G, R, R, R, E, //
+      E, E, E, E, E, E, //
+  };
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(want, buffer, 6 * 5);
+}
+
+void test_clips_top_left() {
+  uint16_t buffer[3 * 2];
+  fill(buffer, 3 * 2);
+  blitAsset(ASSET, buffer, 3, 2, -1, -1);
+
+  // Rows 1 and 2, columns 1 to 3
+  const uint16_t want[3 * 2] = {
+      K, K, K, //
+      R, R, R, //
+  };
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(want, buffer, 3 * 2);
+}
+
+void test_clips_bottom_right() {
+  uint16_t buffer[3 * 2];
+  fill(buffer, 3 * 2);
+  blitAsset(ASSET, buffer, 3, 2, 1, 1);
+
+  const uint16_t E = EMPTY;
+  const uint16_t want[3 * 2] = {
+      E, E, E, //
+      E, R, R, //
+  };
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(want, buffer, 3 * 2);
+}
+
+void test_entirely_outside_writes_nothing() {
+  uint16_t buffer[3 * 2];
+  const int16_t positions[][2] = {{-4, 0}, {3, 0}, {0, -3}, {0, 2}};
+  for (const auto &position : positions) {
+    fill(buffer, 3 * 2);
+    blitAsset(ASSET, buffer, 3, 2, position[0], position[1]);
+    for (int i = 0; i < 3 * 2; i++) {
+      TEST_ASSERT_EQUAL_HEX16(EMPTY, buffer[i]);
+    }
+  }
+}
+
+// Stand-in for GFXcanvas16::drawPixel: an out-of-line call with a bounds
+// check for every pixel
+__attribute__((noinline)) static void drawPixel(uint16_t *buffer, int16_t x,
+                                                int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= 96 || y >= 48) {
+    return;
+  }
+  buffer[y * 96 + x] = color;
+}
+
+// A splash-like 96x48 image: a flat background with a few colored bands,
+// drawn the old way (drawPixel from a raw bitmap) and from its runs
+void test_blit_time_against_raw_bitmap() {
+  const int width = 96;
+  const int height = 48;
+  const int frames = 2000;
+  static uint16_t raw[width * height];
+  static uint8_t runs[width * height * 2];
+  static const uint16_t palette[] = {0x0000, 0x35CC, 0xFFFF};
+
+  size_t runBytes = 0;
+  for (int y = 0; y < height; y++) {
+    int lit = (y >= 6 && y < 42) ? 1 + (y % 2) : 0;
+    int spans[] = {24, 48, 24}; // Background, logo, background
+    int colors[] = {0, lit, 0};
+    int x = 0;
+    for (int i = 0; i < 3; i++) {
+      runs[runBytes++] = spans[i];
+      runs[runBytes++] = colors[i];
+      for (int n = 0; n < spans[i]; n++, x++) {
+        raw[y * width + x] = palette[colors[i]];
+      }
+    }
+  }
+  const Asset asset = {width, height, palette, runs};
+
+  static uint16_t perPixel[width * height];
+  static uint16_t blitted[width * height];
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        drawPixel(perPixel, x, y, raw[y * width + x]);
+      }
+    }
+  }
+  auto middle = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++) {
+    blitAsset(asset, blitted, width, height, 0, 0);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(perPixel, blitted, width * height);
+
+  using us = std::chrono::duration<double, std::micro>;
+  printf("raw bitmap: %d bytes, %.2fus per frame\n", width * height * 2,
+         us(middle - start).count() / frames);
+  printf("compressed: %d bytes, %.2fus per frame\n",
+         (int)(sizeof(palette) + runBytes), us(end - middle).count() / frames);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_rows_in_place);
+  RUN_TEST(test_clips_top_left);
+  RUN_TEST(test_clips_bottom_right);
+  RUN_TEST(test_entirely_outside_writes_nothing);
+  RUN_TEST(test_blit_time_against_raw_bitmap);
+  return UNITY_END();
+}
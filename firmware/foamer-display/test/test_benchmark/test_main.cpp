@@ -0,0 +1,224 @@
+// Microbenchmarks of the data path on the captures in notes/static: time,
+// allocations, bytes and peak heap of parsing, decoding and drawing.
+// ArduinoJson gets a counting allocator; other code is counted through
+// operator new, and the decode and draw steps must not allocate at all.
+// Usage: pio test -e native -f test_benchmark -v
+
+#include "board_view.h"
+#include "departures.h"
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+
+// Heap allocations outside ArduinoJson
+static size_t newCount = 0;
+
+void *operator new(size_t size) {
+  newCount++;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// ArduinoJson allocator that counts calls and tracks live and peak bytes.
+// Each block carries its size in a header so frees can be accounted for.
+class CountingAllocator : public ArduinoJson::Allocator {
+public:
+  void *allocate(size_t size) override {
+    allocations++;
+    char *block = static_cast<char *>(malloc(HEADER + size));
+    if (!block) {
+      return nullptr;
+    }
+    track(block, size);
+    return block + HEADER;
+  }
+
+  void deallocate(void *ptr) override {
+    if (!ptr) {
+      return;
+    }
+    char *block = static_cast<char *>(ptr) - HEADER;
+    live -= sizeOf(block);
+    free(block);
+  }
+
+  void *reallocate(void *ptr, size_t size) override {
+    if (!ptr) {
+      return allocate(size);
+    }
+    reallocations++;
+    char *block = static_cast<char *>(ptr) - HEADER;
+    live -= sizeOf(block);
+    char *moved = static_cast<char *>(realloc(block, HEADER + size));
+    if (!moved) {
+      live += sizeOf(block);
+      return nullptr;
+    }
+    track(moved, size);
+    return moved + HEADER;
+  }
+
+  void reset() {
+    allocations = 0;
+    reallocations = 0;
+    bytes = 0;
+    peak = live;
+  }
+
+  size_t allocations = 0;
+  size_t reallocations = 0;
+  size_t bytes = 0; // Total requested, including growth by reallocate()
+  size_t live = 0;
+  size_t peak = 0;
+
+private:
+  static const size_t HEADER = alignof(std::max_align_t);
+
+  static size_t sizeOf(const char *block) {
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    return size;
+  }
+
+  void track(char *block, size_t size) {
+    memcpy(block, &size, sizeof(size));
+    bytes += size;
+    live += size;
+    if (live > peak) {
+      peak = live;
+    }
+  }
+};
+
+static CountingAllocator allocator;
+
+struct Measurement {
+  double us;          // Per run
+  double allocations; // Per run, ArduinoJson and operator new together
+  double bytes;       // Per run, ArduinoJson only
+  size_t peak;        // Most ArduinoJson bytes live at once
+};
+
+template <typename Fn> Measurement measure(const char *name, int runs, Fn fn) {
+  fn(); // Warm up, e.g. the static filter document
+  allocator.reset();
+  size_t newBefore = newCount;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  Measurement m;
+  m.us = std::chrono::duration<double, std::micro>(end - start).count() / runs;
+  m.allocations =
+      double(allocator.allocations + allocator.reallocations +
+             (newCount - newBefore)) /
+      runs;
+  m.bytes = double(allocator.bytes) / runs;
+  m.peak = allocator.peak;
+  printf("%-32s %9.2fus %7.1f allocs %9.0f bytes %8zu peak\n", name, m.us,
+         m.allocations, m.bytes, m.peak);
+  return m;
+}
+
+static std::string readCapture(const char *name) {
+  std::ifstream file(std::string(NOTES_STATIC_DIR) + "/" + name);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Whole documents, the way a naive client would parse them
+void test_parse_captures() {
+  const char *captures[] = {"foamer-example.json", "nearby-routes-example.json",
+                            "nearby-stops-example.json",
+                            "stop-departures-example.json"};
+  for (const char *capture : captures) {
+    std::string json = readCapture(capture);
+    TEST_ASSERT_GREATER_THAN(0, json.size());
+
+    std::string name = std::string("deserializeJson ") + capture;
+    measure(name.c_str(), 200, [&]() {
+      JsonDocument doc(&allocator);
+      TEST_ASSERT_FALSE(deserializeJson(doc, json));
+    });
+  }
+}
+
+// What the device does with a /departures response
+void test_departures_path() {
+  std::string json = readCapture("foamer-example.json");
+
+  Measurement whole = measure("deserializeJson departures", 2000, [&]() {
+    JsonDocument doc(&allocator);
+    deserializeJson(doc, json);
+  });
+  Measurement filtered = measure("parseDepartures json", 2000, [&]() {
+    JsonDocument doc(&allocator);
+    TEST_ASSERT_FALSE(parseDepartures(json, doc));
+  });
+  TEST_ASSERT_LESS_THAN(whole.peak, filtered.peak);
+
+  std::string msgpack;
+  {
+    JsonDocument doc;
+    deserializeJson(doc, json);
+    serializeMsgPack(doc, msgpack);
+  }
+  measure("parseDeparturesMsgPack", 2000, [&]() {
+    JsonDocument doc(&allocator);
+    TEST_ASSERT_FALSE(parseDeparturesMsgPack(msgpack, doc));
+  });
+
+  // Decoding only reads the document and writes the fixed-size board
+  JsonDocument doc(&allocator);
+  parseDepartures(json, doc);
+  static DepartureBoard board;
+  Measurement decode = measure("decodeDepartures", 20000, [&]() {
+    TEST_ASSERT_TRUE(decodeDepartures(doc, board, 1000, 0));
+  });
+  TEST_ASSERT_EQUAL(0, decode.allocations);
+
+  JsonVariantConst color = doc["routes"][0]["color"];
+  volatile uint16_t sink = 0;
+  Measurement colors = measure("routeColorRgb + rgbToColor565", 200000, [&]() {
+    sink = rgbToColor565(routeColorRgb(color));
+  });
+  TEST_ASSERT_EQUAL(0, colors.allocations);
+  (void)sink;
+
+  // Header, headsign and minutes formatting of a page, with solid glyphs
+  static TextRenderer::Glyph glyphs[256];
+  memset(glyphs, 0x1F, sizeof(glyphs));
+  static uint16_t frame[96 * 48];
+  TextRenderer text(glyphs, frame, 96, 48);
+  Measurement draw = measure("drawRoutePage", 20000, [&]() {
+    memset(frame, 0, sizeof(frame));
+    drawRoutePage(text, board, 0, 1000);
+  });
+  TEST_ASSERT_EQUAL(0, draw.allocations);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_captures);
+  RUN_TEST(test_departures_path);
+  return UNITY_END();
+}
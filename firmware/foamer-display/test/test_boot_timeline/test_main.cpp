@@ -0,0 +1,61 @@
+// Boot timeline with a fake clock
+
+#include "boot_timeline.h"
+#include <string.h>
+#include <unity.h>
+
+static uint32_t fakeNowMs = 0;
+static uint32_t fakeClock() { return fakeNowMs; }
+
+void setUp() { fakeNowMs = 0; }
+void tearDown() {}
+
+void test_marks_each_stage_once() {
+  BootTimeline timeline(fakeClock);
+  TEST_ASSERT_FALSE(timeline.reached(BOOT_DISPLAY));
+
+  // Reached at 0 is still reached
+  TEST_ASSERT_TRUE(timeline.mark(BOOT_DISPLAY));
+  TEST_ASSERT_TRUE(timeline.reached(BOOT_DISPLAY));
+  TEST_ASSERT_EQUAL(0, timeline.at(BOOT_DISPLAY));
+
+  fakeNowMs = 800;
+  TEST_ASSERT_TRUE(timeline.mark(BOOT_WIFI));
+  fakeNowMs = 900;
+  TEST_ASSERT_FALSE(timeline.mark(BOOT_WIFI));
+  TEST_ASSERT_EQUAL(800, timeline.at(BOOT_WIFI));
+  TEST_ASSERT_EQUAL(0, timeline.at(BOOT_MQTT));
+}
+
+// Stages are listed in stage order whatever order they were reached in
+void test_format_lists_reached_stages() {
+  BootTimeline timeline(fakeClock);
+  char out[96];
+  TEST_ASSERT_EQUAL(0, timeline.format(out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("", out);
+
+  fakeNowMs = 120;
+  timeline.mark(BOOT_DISPLAY);
+  fakeNowMs = 812;
+  timeline.mark(BOOT_WIFI);
+  fakeNowMs = 2400;
+  timeline.mark(BOOT_TIME);
+  fakeNowMs = 1630;
+  timeline.mark(BOOT_FIRST_FETCH);
+
+  size_t length = timeline.format(out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("display=120 wifi=812 fetch=1630 time=2400", out);
+  TEST_ASSERT_EQUAL(strlen(out), length);
+
+  // What doesn't fit is left off at a stage boundary
+  char small[24];
+  timeline.format(small, sizeof(small));
+  TEST_ASSERT_EQUAL_STRING("display=120 wifi=812", small);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_marks_each_stage_once);
+  RUN_TEST(test_format_lists_reached_stages);
+  return UNITY_END();
+}
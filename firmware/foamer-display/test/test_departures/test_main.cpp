@@ -0,0 +1,372 @@
+// Replays captured /departures payloads through the parser in small chunks,
+// the way they arrive off a WiFiClient, and compares the peak heap of the
+// streaming path against buffering the body first, and the JSON encoding
+// against the compact MessagePack one.
+
+#include "departures.h"
+#include <ArduinoJson.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+// Allocator that tracks live and peak bytes held by a JsonDocument
+class CountingAllocator : public ArduinoJson::Allocator {
+public:
+  size_t live = 0;
+  size_t peak = 0;
+
+  void *allocate(size_t size) override {
+    size_t *block = static_cast<size_t *>(malloc(size + sizeof(size_t)));
+    block[0] = size;
+    track(size, 0);
+    return block + 1;
+  }
+
+  void deallocate(void *ptr) override {
+    size_t *block = static_cast<size_t *>(ptr) - 1;
+    track(0, block[0]);
+    free(block);
+  }
+
+  void *reallocate(void *ptr, size_t newSize) override {
+    size_t *block = static_cast<size_t *>(ptr) - 1;
+    size_t oldSize = block[0];
+    block = static_cast<size_t *>(realloc(block, newSize + sizeof(size_t)));
+    block[0] = newSize;
+    track(newSize, oldSize);
+    return block + 1;
+  }
+
+private:
+  void track(size_t added, size_t removed) {
+    live = live + added - removed;
+    if (live > peak) {
+      peak = live;
+    }
+  }
+};
+
+// Reader that hands out at most chunkSize bytes per readBytes() call, like a
+// socket delivering TCP segments
+class ChunkedReader {
+public:
+  ChunkedReader(const std::string &data, size_t chunkSize)
+      : data(data), chunkSize(chunkSize) {}
+
+  int read() {
+    if (pos >= data.size()) {
+      return -1;
+    }
+    return static_cast<unsigned char>(data[pos++]);
+  }
+
+  size_t readBytes(char *buffer, size_t length) {
+    size_t n = length < chunkSize ? length : chunkSize;
+    if (n > data.size() - pos) {
+      n = data.size() - pos;
+    }
+    memcpy(buffer, data.data() + pos, n);
+    pos += n;
+    return n;
+  }
+
+private:
+  const std::string &data;
+  size_t chunkSize;
+  size_t pos = 0;
+};
+
+std::string readFixture(const char *name) {
+  std::ifstream file(std::string(NOTES_STATIC_DIR) + "/" + name);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_chunked_stream_matches_buffered() {
+  std::string payload = readFixture("foamer-example.json");
+  TEST_ASSERT_TRUE(payload.size() > 0);
+
+  JsonDocument buffered;
+  TEST_ASSERT_FALSE(deserializeJson(buffered, payload));
+
+  const size_t chunkSizes[] = {1, 7, 64, 1460};
+  for (size_t chunkSize : chunkSizes) {
+    ChunkedReader reader(payload, chunkSize);
+    JsonDocument streamed;
+    TEST_ASSERT_FALSE(parseDepartures(reader, streamed));
+
+    JsonArray expected = buffered["routes"];
+    JsonArray actual = streamed["routes"];
+    TEST_ASSERT_EQUAL(expected.size(), actual.size());
+
+    for (size_t i = 0; i < expected.size(); i++) {
+      TEST_ASSERT_EQUAL_STRING(expected[i]["name"], actual[i]["name"]);
+      TEST_ASSERT_EQUAL_STRING(expected[i]["color"], actual[i]["color"]);
+      JsonArray directions = actual[i]["directions"];
+      for (size_t j = 0; j < directions.size(); j++) {
+        JsonVariant want = expected[i]["directions"][j];
+        JsonVariant got = directions[j];
+        TEST_ASSERT_EQUAL_STRING(want["headsign"], got["headsign"]);
+        TEST_ASSERT_EQUAL(want["departures"].size(), got["departures"].size());
+        TEST_ASSERT_EQUAL(want["departures"][0]["minutes"].as<int>(),
+                          got["departures"][0]["minutes"].as<int>());
+        TEST_ASSERT_EQUAL_STRING(want["departures"][0]["type"],
+                                 got["departures"][0]["type"]);
+      }
+    }
+  }
+}
+
+void test_filter_drops_unrendered_fields() {
+  const char *payload =
+      R"({"routes":[{"name":"Red","mode":"METRORail","color":"e41937",)"
+      R"("stop":{"id":"X","lat":1.0},"directions":[{"headsign":"North",)"
+      R"("extra":[1,2,3],"departures":[{"type":"RealTime","minutes":3,)"
+      R"("trip_id":"abc"}]}]}],"message":["hi"],"debug":{"took_ms":12}})";
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(parseDepartures(payload, doc));
+
+  TEST_ASSERT_TRUE(doc["debug"].isNull());
+  TEST_ASSERT_TRUE(doc["routes"][0]["stop"].isNull());
+  TEST_ASSERT_TRUE(doc["routes"][0]["directions"][0]["extra"].isNull());
+  TEST_ASSERT_TRUE(
+      doc["routes"][0]["directions"][0]["departures"][0]["trip_id"].isNull());
+  TEST_ASSERT_EQUAL(
+      3, doc["routes"][0]["directions"][0]["departures"][0]["minutes"].as<int>());
+  TEST_ASSERT_EQUAL_STRING("hi", doc["message"][0]);
+}
+
+void test_streaming_peak_heap_below_buffered() {
+  std::string payload = readFixture("foamer-example.json");
+
+  // Buffered path: the whole body is resident while the document grows
+  CountingAllocator bufferedAllocator;
+  {
+    JsonDocument doc(&bufferedAllocator);
+    TEST_ASSERT_FALSE(deserializeJson(doc, payload));
+  }
+  size_t bufferedPeak = payload.size() + bufferedAllocator.peak;
+
+  // Streaming path: only the filtered document is ever held
+  CountingAllocator streamingAllocator;
+  {
+    ChunkedReader reader(payload, 64);
+    JsonDocument doc(&streamingAllocator);
+    TEST_ASSERT_FALSE(parseDepartures(reader, doc));
+  }
+  size_t streamingPeak = streamingAllocator.peak;
+
+  printf("payload: %zu bytes, peak buffered: %zu, peak streaming: %zu\n",
+         payload.size(), bufferedPeak, streamingPeak);
+  TEST_ASSERT_LESS_THAN(bufferedPeak, streamingPeak);
+}
+
+// Re-encode a JSON payload the way the server's compact MessagePack encoding
+// does: departure type as 0/1 and color as packed 0xRRGGBB
+std::string toCompactMsgPack(const std::string &json) {
+  JsonDocument doc;
+  deserializeJson(doc, json);
+  for (JsonObject route : doc["routes"].as<JsonArray>()) {
+    route["color"] = routeColorRgb(route["color"]);
+    for (JsonObject direction : route["directions"].as<JsonArray>()) {
+      for (JsonObject dep : direction["departures"].as<JsonArray>()) {
+        dep["type"] = isRealTime(dep["type"]) ? 1 : 0;
+      }
+    }
+  }
+  std::string out;
+  serializeMsgPack(doc, out);
+  return out;
+}
+
+template <typename TParse> double averageParseUs(TParse parse) {
+  const int iterations = 1000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    parse();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count() /
+         iterations;
+}
+
+void test_msgpack_smaller_and_decodes_the_same() {
+  std::string json = readFixture("foamer-example.json");
+  std::string msgpack = toCompactMsgPack(json);
+
+  JsonDocument fromJson;
+  JsonDocument fromMsgPack;
+  TEST_ASSERT_FALSE(parseDepartures(json, fromJson));
+  TEST_ASSERT_FALSE(parseDeparturesMsgPack(msgpack, fromMsgPack));
+
+  JsonVariant want = fromJson["routes"][1];
+  JsonVariant got = fromMsgPack["routes"][1];
+  TEST_ASSERT_EQUAL_STRING(want["name"], got["name"]);
+  TEST_ASSERT_EQUAL_HEX32(routeColorRgb(want["color"]),
+                          routeColorRgb(got["color"]));
+  TEST_ASSERT_EQUAL(
+      isRealTime(want["directions"][0]["departures"][0]["type"]),
+      isRealTime(got["directions"][0]["departures"][0]["type"]));
+  TEST_ASSERT_TRUE(isRealTime(got["directions"][0]["departures"][0]["type"]));
+
+  double jsonUs = averageParseUs([&] {
+    JsonDocument doc;
+    parseDepartures(json, doc);
+  });
+  double msgpackUs = averageParseUs([&] {
+    JsonDocument doc;
+    parseDeparturesMsgPack(msgpack, doc);
+  });
+
+  printf("json: %zu bytes, %.1f us/parse; msgpack: %zu bytes, %.1f us/parse\n",
+         json.size(), jsonUs, msgpack.size(), msgpackUs);
+  TEST_ASSERT_LESS_THAN(json.size(), msgpack.size());
+}
+
+void test_decode_into_board() {
+  std::string payload = readFixture("foamer-example.json");
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(parseDepartures(payload, doc));
+
+  DepartureBoard board;
+  TEST_ASSERT_TRUE(decodeDepartures(doc, board, 0, 0));
+  TEST_ASSERT_EQUAL(8, board.routeCount);
+  TEST_ASSERT_EQUAL_UINT32(0, board.fetchedEpoch);
+  TEST_ASSERT_EQUAL(0, board.messageLineCount);
+
+  const Route &red = board.routes[0];
+  TEST_ASSERT_EQUAL_STRING("RED METRORail", red.header);
+  TEST_ASSERT_EQUAL_HEX16(rgbToColor565(0xe41937), red.color);
+  TEST_ASSERT_EQUAL(2, red.directionCount);
+  TEST_ASSERT_EQUAL_STRING("FANNIN", red.directions[0].headsign);
+  TEST_ASSERT_EQUAL(3, red.directions[0].departureCount);
+  TEST_ASSERT_EQUAL(12, minutesUntil(red.directions[0].departures[1], 0));
+  TEST_ASSERT_FALSE(red.directions[0].departures[1].realtime);
+
+  // Short headsigns are padded to the column width
+  const Route &uss = board.routes[6];
+  TEST_ASSERT_EQUAL(1, uss.directionCount);
+  TEST_ASSERT_EQUAL(HEADSIGN_WIDTH, strlen(uss.directions[0].headsign));
+
+  const Route &bus5 = board.routes[1];
+  TEST_ASSERT_TRUE(bus5.directions[0].departures[0].realtime);
+  TEST_ASSERT_EQUAL(2, bus5.directions[1].departureCount);
+}
+
+// MQTT hands over the payload as a byte buffer with a length and no
+// terminator; either encoding must decode to the same board as HTTP
+void test_pushed_payload_decodes_the_same() {
+  std::string json = readFixture("foamer-example.json");
+  std::string msgpack = toCompactMsgPack(json);
+
+  JsonDocument fetched;
+  TEST_ASSERT_FALSE(parseDepartures(json, fetched));
+  DepartureBoard want;
+  decodeDepartures(fetched, want, 0, 0);
+
+  std::vector<uint8_t> jsonPayload(json.begin(), json.end());
+  std::vector<uint8_t> msgpackPayload(msgpack.begin(), msgpack.end());
+  JsonDocument fromJson;
+  JsonDocument fromMsgPack;
+  TEST_ASSERT_FALSE(
+      parseDepartures(jsonPayload.data(), jsonPayload.size(), fromJson));
+  TEST_ASSERT_FALSE(parseDeparturesMsgPack(msgpackPayload.data(),
+                                           msgpackPayload.size(), fromMsgPack));
+
+  JsonDocument *pushed[] = {&fromJson, &fromMsgPack};
+  for (JsonDocument *doc : pushed) {
+    DepartureBoard got;
+    decodeDepartures(*doc, got, 0, 0);
+    TEST_ASSERT_EQUAL(want.routeCount, got.routeCount);
+    TEST_ASSERT_EQUAL_STRING(want.routes[1].header, got.routes[1].header);
+    TEST_ASSERT_EQUAL_HEX16(want.routes[1].color, got.routes[1].color);
+    TEST_ASSERT_EQUAL_STRING(want.routes[1].directions[0].headsign,
+                             got.routes[1].directions[0].headsign);
+    TEST_ASSERT_EQUAL_UINT32(want.routes[1].directions[0].departures[0].dueMs,
+                             got.routes[1].directions[0].departures[0].dueMs);
+  }
+}
+
+void test_decode_caps_lists_and_message() {
+  JsonDocument doc;
+  JsonObject direction = doc["routes"][0]["directions"][0].to<JsonObject>();
+  doc["routes"][0]["name"] = "a-very-long-route-name";
+  doc["routes"][0]["mode"] = "Bus";
+  doc["routes"][0]["color"] = "ffffff";
+  direction["headsign"] = "Downtown Transit Center";
+  for (int i = 0; i < 8; i++) {
+    JsonObject dep = direction["departures"].add<JsonObject>();
+    dep["type"] = "Scheduled";
+    dep["minutes"] = i;
+  }
+  doc["routes"][0]["directions"].add(direction);
+  doc["routes"][0]["directions"].add(direction);
+  doc["message"].add("Congratulations!");
+
+  DepartureBoard board;
+  TEST_ASSERT_TRUE(decodeDepartures(doc, board, 0, 0));
+  const Route &route = board.routes[0];
+  TEST_ASSERT_EQUAL_STRING("A-VERY-LONG-ROUT", route.header);
+  TEST_ASSERT_EQUAL(MAX_DIRECTIONS, route.directionCount);
+  TEST_ASSERT_EQUAL_STRING("DOWNTO", route.directions[0].headsign);
+  TEST_ASSERT_EQUAL(MAX_STORED_DEPARTURES, route.directions[0].departureCount);
+  TEST_ASSERT_EQUAL(1, board.messageLineCount);
+  TEST_ASSERT_EQUAL_STRING("Congratulations!", board.message[0]);
+}
+
+// Parsed through the filter like on the device, so "at" has to survive it
+void test_departures_count_down_locally() {
+  const uint32_t fetchEpoch = 1760000000;
+  const uint32_t fetchMs = 5000;
+
+  // The first departure has the absolute time newer servers send, the
+  // second only the minutes of older servers
+  const char *payload =
+      R"({"routes":[{"name":"Red","mode":"METRORail","color":"e41937",)"
+      R"("directions":[{"headsign":"North","departures":[)"
+      R"({"type":"RealTime","minutes":1,"at":1760000090},)"
+      R"({"type":"Scheduled","minutes":10}]}]}]})";
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(parseDepartures(payload, doc));
+
+  DepartureBoard board;
+  TEST_ASSERT_TRUE(decodeDepartures(doc, board, fetchMs, fetchEpoch));
+  TEST_ASSERT_EQUAL_UINT32(fetchEpoch, board.fetchedEpoch);
+  const Direction &decoded = board.routes[0].directions[0];
+
+  TEST_ASSERT_EQUAL(1, minutesUntil(decoded.departures[0], fetchMs));
+  TEST_ASSERT_EQUAL(10, minutesUntil(decoded.departures[1], fetchMs));
+
+  // A minute later both have counted down
+  TEST_ASSERT_EQUAL(0, minutesUntil(decoded.departures[0], fetchMs + 60000));
+  TEST_ASSERT_EQUAL(9, minutesUntil(decoded.departures[1], fetchMs + 60000));
+
+  // The first one leaves 90s after the fetch and drops off
+  TEST_ASSERT_EQUAL(0, minutesUntil(decoded.departures[0], fetchMs + 89999));
+  TEST_ASSERT_EQUAL(-1, minutesUntil(decoded.departures[0], fetchMs + 90001));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_chunked_stream_matches_buffered);
+  RUN_TEST(test_filter_drops_unrendered_fields);
+  RUN_TEST(test_streaming_peak_heap_below_buffered);
+  RUN_TEST(test_msgpack_smaller_and_decodes_the_same);
+  RUN_TEST(test_decode_into_board);
+  RUN_TEST(test_pushed_payload_decodes_the_same);
+  RUN_TEST(test_decode_caps_lists_and_message);
+  RUN_TEST(test_departures_count_down_locally);
+  return UNITY_END();
+}
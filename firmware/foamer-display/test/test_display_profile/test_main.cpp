@@ -0,0 +1,61 @@
+// Display profiles and the refresh rate the DMA driver gets out of them on
+// the 96x48 panel
+
+#include "display_profile.h"
+#include <stdio.h>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_profiles_by_name() {
+  const DisplayProfile *full = findDisplayProfile("full");
+  TEST_ASSERT_NOT_NULL(full);
+  TEST_ASSERT_EQUAL(full, &defaultDisplayProfile());
+  TEST_ASSERT_EQUAL(8, full->colorDepthBits);
+
+  TEST_ASSERT_NOT_NULL(findDisplayProfile("balanced"));
+  TEST_ASSERT_NOT_NULL(findDisplayProfile("flat"));
+  TEST_ASSERT_NULL(findDisplayProfile("Flat"));
+  TEST_ASSERT_NULL(findDisplayProfile(nullptr));
+}
+
+// 8 bits at 8 MHz: with every plane at its full weight a 96 pixel row takes
+// 255 shifts of 12us, 13Hz over 24 rows, so the driver shows the low planes
+// once until 60Hz is reached
+void test_full_depth_trades_timing_for_minimum() {
+  DisplayProfile profile = *findDisplayProfile("full");
+  uint32_t refreshHz = estimateRefreshHz(profile, 96, 48);
+  TEST_ASSERT_GREATER_OR_EQUAL(60, refreshHz);
+  TEST_ASSERT_LESS_THAN(200, refreshHz);
+
+  profile.minRefreshHz = 1;
+  TEST_ASSERT_EQUAL(13, estimateRefreshHz(profile, 96, 48));
+}
+
+// Fewer bit planes and a faster clock refresh faster, without giving up
+// any color timing
+void test_cheaper_profiles_refresh_faster() {
+  const char *names[] = {"full", "balanced", "flat"};
+  uint32_t previousHz = 0;
+  for (const char *name : names) {
+    const DisplayProfile &profile = *findDisplayProfile(name);
+    uint32_t refreshHz = estimateRefreshHz(profile, 96, 48);
+    printf("%-8s %u bits %2u MHz: %4u Hz\n", name, profile.colorDepthBits,
+           (unsigned)(profile.i2sSpeedHz / 1000000), (unsigned)refreshHz);
+    TEST_ASSERT_GREATER_OR_EQUAL(profile.minRefreshHz, refreshHz);
+    TEST_ASSERT_GREATER_THAN(previousHz, refreshHz);
+    previousHz = refreshHz;
+  }
+
+  // 3 planes at full weight: 7 shifts of 9.6us per row
+  TEST_ASSERT_EQUAL(620, previousHz);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_profiles_by_name);
+  RUN_TEST(test_full_depth_trades_timing_for_minimum);
+  RUN_TEST(test_cheaper_profiles_refresh_faster);
+  return UNITY_END();
+}
@@ -0,0 +1,73 @@
+// Checks the triple buffer hands over whole snapshots between threads
+
+#include "handoff.h"
+#include <thread>
+#include <unity.h>
+
+struct Snapshot {
+  uint32_t version;
+  uint32_t values[64]; // All equal to version when consistent
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_reader_sees_latest_publish() {
+  TripleBuffer<Snapshot> buffer;
+  TEST_ASSERT_FALSE(buffer.update());
+
+  buffer.back().version = 1;
+  buffer.publish();
+  buffer.back().version = 2;
+  buffer.publish();
+
+  TEST_ASSERT_TRUE(buffer.update());
+  TEST_ASSERT_EQUAL_UINT32(2, buffer.front().version);
+
+  // Nothing new since the last update
+  TEST_ASSERT_FALSE(buffer.update());
+  TEST_ASSERT_EQUAL_UINT32(2, buffer.front().version);
+}
+
+void test_snapshots_are_never_torn() {
+  TripleBuffer<Snapshot> buffer;
+  const uint32_t publishes = 200000;
+
+  std::thread writer([&] {
+    for (uint32_t version = 1; version <= publishes; version++) {
+      Snapshot &snapshot = buffer.back();
+      snapshot.version = version;
+      for (uint32_t &value : snapshot.values) {
+        value = version;
+      }
+      buffer.publish();
+    }
+  });
+
+  uint32_t lastVersion = 0;
+  int torn = 0;
+  while (lastVersion < publishes) {
+    if (!buffer.update()) {
+      continue;
+    }
+    const Snapshot &snapshot = buffer.front();
+    for (uint32_t value : snapshot.values) {
+      if (value != snapshot.version) {
+        torn++;
+      }
+    }
+    // Versions only move forward
+    TEST_ASSERT_GREATER_THAN(lastVersion, snapshot.version);
+    lastVersion = snapshot.version;
+  }
+  writer.join();
+
+  TEST_ASSERT_EQUAL(0, torn);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reader_sees_latest_publish);
+  RUN_TEST(test_snapshots_are_never_torn);
+  return UNITY_END();
+}
@@ -0,0 +1,180 @@
+// Log ring and CloudWatch batch encoding, on the host
+
+#include "log.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unity.h>
+
+static uint32_t fakeNowMs = 0;
+static uint32_t fakeClock() { return fakeNowMs; }
+
+static bool writeTo(LogBuffer &buffer, uint8_t level, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  bool stored = buffer.write(level, fakeNowMs, format, args);
+  va_end(args);
+  return stored;
+}
+
+static void drain(LogBuffer &buffer) {
+  LogEntry entry;
+  while (buffer.read(entry)) {
+  }
+}
+
+void setUp() {
+  fakeNowMs = 0;
+  logBegin(fakeClock);
+  drain(logBuffer);
+  logBuffer.takeDropped();
+}
+void tearDown() {}
+
+void test_entries_come_out_in_order() {
+  LogBuffer buffer;
+  fakeNowMs = 10;
+  TEST_ASSERT_TRUE(writeTo(buffer, LOG_LEVEL_INFO, "fetched %d routes", 8));
+  fakeNowMs = 20;
+  TEST_ASSERT_TRUE(writeTo(buffer, LOG_LEVEL_ERROR, "HTTP %d", 503));
+
+  LogEntry entry;
+  TEST_ASSERT_TRUE(buffer.read(entry));
+  TEST_ASSERT_EQUAL_UINT32(10, entry.timeMs);
+  TEST_ASSERT_EQUAL(LOG_LEVEL_INFO, entry.level);
+  TEST_ASSERT_EQUAL_STRING("fetched 8 routes", entry.message);
+  TEST_ASSERT_TRUE(buffer.read(entry));
+  TEST_ASSERT_EQUAL_STRING("HTTP 503", entry.message);
+  TEST_ASSERT_FALSE(buffer.read(entry));
+}
+
+void test_full_ring_drops_and_counts() {
+  LogBuffer buffer;
+  for (size_t i = 0; i < LOG_CAPACITY; i++) {
+    TEST_ASSERT_TRUE(writeTo(buffer, LOG_LEVEL_INFO, "line %u", (unsigned)i));
+  }
+  TEST_ASSERT_FALSE(writeTo(buffer, LOG_LEVEL_INFO, "one too many"));
+  TEST_ASSERT_FALSE(writeTo(buffer, LOG_LEVEL_INFO, "two too many"));
+  TEST_ASSERT_EQUAL_UINT32(2, buffer.takeDropped());
+  TEST_ASSERT_EQUAL_UINT32(0, buffer.takeDropped());
+
+  // The oldest lines are kept, and the ring wraps once drained
+  LogEntry entry;
+  TEST_ASSERT_TRUE(buffer.read(entry));
+  TEST_ASSERT_EQUAL_STRING("line 0", entry.message);
+  TEST_ASSERT_TRUE(writeTo(buffer, LOG_LEVEL_INFO, "after wrap"));
+  drain(buffer);
+  TEST_ASSERT_EQUAL_UINT32(2, buffer.totalDropped());
+}
+
+void test_long_messages_are_truncated() {
+  LogBuffer buffer;
+  std::string body(500, 'x');
+  TEST_ASSERT_TRUE(writeTo(buffer, LOG_LEVEL_ERROR, "body %s", body.c_str()));
+
+  LogEntry entry;
+  TEST_ASSERT_TRUE(buffer.read(entry));
+  TEST_ASSERT_EQUAL(LOG_MESSAGE_SIZE - 1, strlen(entry.message));
+}
+
+void test_debug_compiles_out() {
+  int evaluated = 0;
+  LOG_DEBUG("count %d", ++evaluated);
+  LOG_INFO("count %d", ++evaluated);
+
+  TEST_ASSERT_EQUAL(1, evaluated);
+  LogEntry entry;
+  TEST_ASSERT_TRUE(logBuffer.read(entry));
+  TEST_ASSERT_EQUAL_STRING("count 1", entry.message);
+  TEST_ASSERT_FALSE(logBuffer.read(entry));
+}
+
+void test_batch_encodes_cloudwatch_records() {
+  char payload[512];
+  LogBatch batch(payload, sizeof(payload));
+  TEST_ASSERT_EQUAL_STRING("[]", batch.payload());
+
+  TEST_ASSERT_TRUE(batch.add(1700000000123ULL, LOG_LEVEL_INFO, "foamer-dev-1",
+                             "say \"hi\"\n"));
+  TEST_ASSERT_TRUE(batch.add(1700000000456ULL, LOG_LEVEL_WARN, "foamer-dev-1",
+                             "tab\there"));
+  TEST_ASSERT_EQUAL(2, batch.count());
+
+  const char *want =
+      R"([{"timestamp":1700000000123,"message":"{\"thing_name\":\"foamer-dev-1\",)"
+      R"(\"level\":\"INFO\",\"message\":\"say \\\"hi\\\"\\u000a\"}"},)"
+      R"({"timestamp":1700000000456,"message":"{\"thing_name\":\"foamer-dev-1\",)"
+      R"(\"level\":\"WARNING\",\"message\":\"tab\\u0009here\"}"}])";
+  TEST_ASSERT_EQUAL_STRING(want, batch.payload());
+  TEST_ASSERT_EQUAL(strlen(want), batch.length());
+}
+
+void test_full_batch_rejects_without_corrupting() {
+  char payload[200];
+  LogBatch batch(payload, sizeof(payload));
+  TEST_ASSERT_TRUE(batch.add(1, LOG_LEVEL_INFO, "t", "first"));
+  std::string before = batch.payload();
+
+  TEST_ASSERT_FALSE(batch.add(2, LOG_LEVEL_INFO, "t", std::string(100, 'y').c_str()));
+  TEST_ASSERT_EQUAL(1, batch.count());
+  TEST_ASSERT_EQUAL_STRING(before.c_str(), batch.payload());
+
+  batch.clear();
+  TEST_ASSERT_TRUE(batch.add(2, LOG_LEVEL_INFO, "t", std::string(100, 'y').c_str()));
+}
+
+// Two writer tasks and the flushing task: every line is either read or
+// counted as dropped, and none come out torn
+void test_concurrent_writers() {
+  const int perWriter = 20000;
+  LogBuffer buffer;
+  std::atomic<bool> done(false);
+  int read = 0;
+  bool torn = false;
+
+  std::thread reader([&]() {
+    LogEntry entry;
+    for (;;) {
+      bool more = !done.load();
+      while (buffer.read(entry)) {
+        read++;
+        torn |= strcmp(entry.message, "aaaaaaaaaaaaaaaa") != 0 &&
+                strcmp(entry.message, "bbbbbbbbbbbbbbbb") != 0;
+      }
+      if (!more) {
+        break;
+      }
+    }
+  });
+  auto writer = [&](const char *text) {
+    for (int i = 0; i < perWriter; i++) {
+      writeTo(buffer, LOG_LEVEL_INFO, "%s", text);
+      std::this_thread::yield();
+    }
+  };
+  std::thread a(writer, "aaaaaaaaaaaaaaaa");
+  std::thread b(writer, "bbbbbbbbbbbbbbbb");
+  a.join();
+  b.join();
+  done = true;
+  reader.join();
+
+  printf("read %d, dropped %u of %d\n", read, (unsigned)buffer.totalDropped(),
+         2 * perWriter);
+  TEST_ASSERT_FALSE(torn);
+  TEST_ASSERT_EQUAL(2 * perWriter, read + (int)buffer.totalDropped());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_entries_come_out_in_order);
+  RUN_TEST(test_full_ring_drops_and_counts);
+  RUN_TEST(test_long_messages_are_truncated);
+  RUN_TEST(test_debug_compiles_out);
+  RUN_TEST(test_batch_encodes_cloudwatch_records);
+  RUN_TEST(test_full_batch_rejects_without_corrupting);
+  RUN_TEST(test_concurrent_writers);
+  return UNITY_END();
+}
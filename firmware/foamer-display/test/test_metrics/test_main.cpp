@@ -0,0 +1,133 @@
+// Metrics registry and its report encoding, on the host
+
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_report_encodes_each_kind() {
+  Metrics registry;
+  const uint32_t bounds[] = {10, 100};
+  int reconnects = registry.addCounter("mqtt_reconnects");
+  int latency = registry.addHistogram("fetch_ms", bounds, 2);
+  int idle = registry.addHistogram("idle_ms", bounds, 2);
+  int heap = registry.addLowWaterMark("free_heap");
+  int block = registry.addLowWaterMark("largest_block");
+
+  registry.increment(reconnects);
+  registry.increment(reconnects, 2);
+  registry.record(latency, 10);  // Bounds are inclusive
+  registry.record(latency, 11);
+  registry.record(latency, 500); // Overflow bucket
+  registry.recordLow(heap, 90000);
+  registry.recordLow(heap, 70000);
+  registry.recordLow(heap, 80000);
+  (void)idle;
+  (void)block;
+
+  char out[512];
+  size_t length = registry.report(out, sizeof(out), "\"uptime_s\":60");
+  const char *want =
+      R"({"uptime_s":60,"counters":{"mqtt_reconnects":3},)"
+      R"("histograms":{"fetch_ms":{"n":3,"sum":521,"max":500,"le":[10,100],"b":[1,1,1]},)"
+      R"("idle_ms":{"n":0}},"low_water":{"free_heap":70000}})";
+  TEST_ASSERT_EQUAL_STRING(want, out);
+  TEST_ASSERT_EQUAL(strlen(want), length);
+}
+
+void test_report_starts_a_new_period() {
+  Metrics registry;
+  int fetches = registry.addCounter("fetches");
+  int heap = registry.addLowWaterMark("free_heap");
+  registry.increment(fetches);
+  registry.recordLow(heap, 1000);
+
+  char out[256];
+  TEST_ASSERT_GREATER_THAN(0, registry.report(out, sizeof(out)));
+  registry.report(out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING(
+      R"({"counters":{"fetches":0},"histograms":{},"low_water":{}})", out);
+}
+
+void test_report_that_does_not_fit_keeps_the_period() {
+  Metrics registry;
+  int fetches = registry.addCounter("fetches");
+  registry.increment(fetches, 5);
+
+  char small[16];
+  TEST_ASSERT_EQUAL(0, registry.report(small, sizeof(small)));
+
+  char out[256];
+  registry.report(out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING(
+      R"({"counters":{"fetches":5},"histograms":{},"low_water":{}})", out);
+}
+
+void test_registry_limits() {
+  Metrics registry;
+  for (int i = 0; i < Metrics::MAX_COUNTERS; i++) {
+    TEST_ASSERT_EQUAL(i, registry.addCounter("c"));
+  }
+  TEST_ASSERT_EQUAL(-1, registry.addCounter("one too many"));
+
+  uint32_t bounds[Metrics::MAX_BUCKETS + 1] = {};
+  TEST_ASSERT_EQUAL(-1, registry.addHistogram("h", bounds, sizeof(bounds) / 4));
+
+  // Unregistered ids are ignored
+  registry.increment(-1);
+  registry.record(-1, 1);
+  registry.recordLow(-1, 1);
+}
+
+// Both tasks record while the network task reports: nothing is counted
+// twice or lost across periods
+void test_concurrent_records_are_not_lost() {
+  const uint32_t perWriter = 100000;
+  Metrics registry;
+  int events = registry.addCounter("events");
+  int sizes = registry.addHistogram("sizes", SIZE_BUCKETS_BYTES, 6);
+
+  auto writer = [&]() {
+    for (uint32_t i = 0; i < perWriter; i++) {
+      registry.increment(events);
+      registry.record(sizes, 3000);
+    }
+  };
+  std::thread a(writer);
+  std::thread b(writer);
+
+  unsigned long reportedEvents = 0;
+  unsigned long reportedSizes = 0;
+  auto collect = [&]() {
+    char out[512];
+    TEST_ASSERT_GREATER_THAN(0, registry.report(out, sizeof(out)));
+    unsigned long value = 0;
+    sscanf(strstr(out, "\"events\":"), "\"events\":%lu", &value);
+    reportedEvents += value;
+    sscanf(strstr(out, "\"sizes\":{\"n\":"), "\"sizes\":{\"n\":%lu", &value);
+    reportedSizes += value;
+  };
+  for (int i = 0; i < 50; i++) {
+    collect();
+  }
+  a.join();
+  b.join();
+  collect();
+
+  TEST_ASSERT_EQUAL(2 * perWriter, reportedEvents);
+  TEST_ASSERT_EQUAL(2 * perWriter, reportedSizes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_report_encodes_each_kind);
+  RUN_TEST(test_report_starts_a_new_period);
+  RUN_TEST(test_report_that_does_not_fit_keeps_the_period);
+  RUN_TEST(test_registry_limits);
+  RUN_TEST(test_concurrent_records_are_not_lost);
+  return UNITY_END();
+}
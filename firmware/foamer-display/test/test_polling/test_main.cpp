@@ -0,0 +1,156 @@
+// Simulates the polling policy against a fake clock to show the request rate
+// under normal operation and during a backend outage
+
+#include "polling.h"
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+static const PollingBounds BOUNDS = {
+    30000,  // minMs
+    300000, // maxMs
+    60000,  // realtimeMs
+    10000,  // retryMs
+    600000, // backoffMaxMs
+};
+
+static uint32_t randomState = 1;
+static uint32_t fakeRandom() {
+  // xorshift32, deterministic across runs
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+// One route whose departures leave every headwayMs, starting at nowMs
+static DepartureBoard boardAt(uint32_t nowMs, uint32_t headwayMs,
+                              bool realtime) {
+  DepartureBoard board;
+  memset(&board, 0, sizeof(board));
+  board.routeCount = 1;
+  board.routes[0].directionCount = 1;
+  Direction &direction = board.routes[0].directions[0];
+  direction.departureCount = MAX_STORED_DEPARTURES;
+  for (int i = 0; i < MAX_STORED_DEPARTURES; i++) {
+    direction.departures[i].dueMs = nowMs + headwayMs * (i + 1) - 1;
+    direction.departures[i].realtime = realtime;
+  }
+  return board;
+}
+
+// Run the policy for durationMs, failing every fetch inside
+// [outageStartMs, outageEndMs). Returns the number of requests made.
+static int simulate(uint32_t durationMs, uint32_t headwayMs, bool realtime,
+                    uint32_t outageStartMs, uint32_t outageEndMs,
+                    int *outageRequests) {
+  PollingPolicy policy(BOUNDS, fakeRandom);
+  int requests = 0;
+  *outageRequests = 0;
+
+  for (uint32_t nowMs = 0; nowMs < durationMs;) {
+    requests++;
+    bool failed = nowMs >= outageStartMs && nowMs < outageEndMs;
+    if (failed) {
+      (*outageRequests)++;
+      nowMs += policy.onFailure();
+    } else {
+      DepartureBoard board = boardAt(nowMs, headwayMs, realtime);
+      nowMs += policy.onSuccess(board, nowMs);
+    }
+  }
+  return requests;
+}
+
+void setUp() { randomState = 1; }
+void tearDown() {}
+
+void test_normal_request_rate() {
+  const uint32_t hourMs = 3600000;
+  int outage;
+
+  int scheduled = simulate(hourMs, 12 * 60000, false, 0, 0, &outage);
+  int realtime = simulate(hourMs, 12 * 60000, true, 0, 0, &outage);
+  int frequent = simulate(hourMs, 60000, false, 0, 0, &outage);
+  printf("requests/hour: scheduled %d, realtime %d, 1-min headway %d\n",
+         scheduled, realtime, frequent);
+
+  // Never more often than minMs allows
+  TEST_ASSERT_LESS_OR_EQUAL(hourMs / BOUNDS.minMs, frequent);
+  // Real-time data is refreshed at least every realtimeMs (+10% jitter)
+  TEST_ASSERT_GREATER_OR_EQUAL(hourMs / (BOUNDS.realtimeMs * 11 / 10),
+                               realtime);
+  // Sparse scheduled data is polled far less than real-time data
+  TEST_ASSERT_LESS_THAN(realtime, scheduled);
+}
+
+void test_outage_backs_off() {
+  const uint32_t hourMs = 3600000;
+  int outageRequests;
+
+  // Healthy for an hour, down for two, healthy again for an hour
+  int requests = simulate(4 * hourMs, 12 * 60000, true, hourMs, 3 * hourMs,
+                          &outageRequests);
+  printf("requests: %d total, %d during a 2h outage\n", requests,
+         outageRequests);
+
+  // A flat 10s retry would be 720 requests
+  TEST_ASSERT_LESS_THAN(40, outageRequests);
+}
+
+// A 304 after the soonest departure has left doesn't relax polling back to
+// maxMs: the data is running out
+void test_not_modified_after_soonest_departure_left() {
+  PollingPolicy policy(BOUNDS, fakeRandom);
+  DepartureBoard board = boardAt(0, 4 * 60000, false);
+  uint32_t firstMs = policy.onSuccess(board, 0);
+  TEST_ASSERT_LESS_OR_EQUAL(2 * 60000, firstMs);
+
+  // Still ahead of the first departure: halfway to it
+  TEST_ASSERT_LESS_OR_EQUAL(60000, policy.onNotModified(2 * 60000));
+
+  // It left at 4 minutes
+  uint32_t lateMs = policy.onNotModified(5 * 60000);
+  TEST_ASSERT_GREATER_OR_EQUAL(BOUNDS.minMs, lateMs);
+  TEST_ASSERT_LESS_OR_EQUAL(BOUNDS.minMs * 11 / 10, lateMs);
+}
+
+void test_fleet_retries_spread_out() {
+  const int devices = 100;
+  uint32_t firstRetryMs[devices];
+  uint32_t thirdRetryMs[devices];
+
+  // Every device sees the same failures at the same moment
+  for (int i = 0; i < devices; i++) {
+    PollingPolicy policy(BOUNDS, fakeRandom);
+    firstRetryMs[i] = policy.onFailure();
+    policy.onFailure();
+    thirdRetryMs[i] = policy.onFailure();
+  }
+
+  uint32_t minFirst = firstRetryMs[0], maxFirst = firstRetryMs[0];
+  uint32_t minThird = thirdRetryMs[0], maxThird = thirdRetryMs[0];
+  for (int i = 1; i < devices; i++) {
+    if (firstRetryMs[i] < minFirst) minFirst = firstRetryMs[i];
+    if (firstRetryMs[i] > maxFirst) maxFirst = firstRetryMs[i];
+    if (thirdRetryMs[i] < minThird) minThird = thirdRetryMs[i];
+    if (thirdRetryMs[i] > maxThird) maxThird = thirdRetryMs[i];
+  }
+  printf("retry spread: 1st %u-%ums, 3rd %u-%ums\n", minFirst, maxFirst,
+         minThird, maxThird);
+
+  // Retries land across the upper half of each backoff window
+  TEST_ASSERT_GREATER_OR_EQUAL(BOUNDS.retryMs / 2, minFirst);
+  TEST_ASSERT_LESS_OR_EQUAL(BOUNDS.retryMs, maxFirst);
+  TEST_ASSERT_GREATER_THAN(BOUNDS.retryMs, minThird);
+  TEST_ASSERT_GREATER_THAN(BOUNDS.retryMs, maxThird - minThird);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_normal_request_rate);
+  RUN_TEST(test_outage_backs_off);
+  RUN_TEST(test_not_modified_after_soonest_departure_left);
+  RUN_TEST(test_fleet_retries_spread_out);
+  return UNITY_END();
+}
@@ -0,0 +1,100 @@
+// Steps the MQTT reconnect state machine against a fake clock, including a
+// flaky access point where every attempt fails
+
+#include "reconnect.h"
+#include <unity.h>
+
+static const BackoffBounds BOUNDS = {
+    1000,  // retryMs
+    60000, // maxMs
+};
+
+static uint32_t randomState = 1;
+static uint32_t fakeRandom() {
+  // xorshift32, deterministic across runs
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+void setUp() { randomState = 1; }
+void tearDown() {}
+
+// One blocking step per call: transport, then session, then servicing
+void test_connects_one_step_at_a_time() {
+  Reconnector link(BOUNDS, fakeRandom);
+  TEST_ASSERT_EQUAL(Reconnector::CONNECT_TRANSPORT, link.next(0));
+  link.onTransport(true, 0);
+  TEST_ASSERT_EQUAL(Reconnector::CONNECT_SESSION, link.next(100));
+  TEST_ASSERT_FALSE(link.connected());
+  link.onSession(true, 100);
+  TEST_ASSERT_TRUE(link.connected());
+  TEST_ASSERT_EQUAL(Reconnector::SERVICE, link.next(200));
+  TEST_ASSERT_EQUAL(1, link.attempts());
+
+  // A drop is retried on the next poll, without waiting
+  link.onLost();
+  TEST_ASSERT_EQUAL(Reconnector::CONNECT_TRANSPORT, link.next(300));
+}
+
+void test_failures_back_off_with_jitter() {
+  Reconnector link(BOUNDS, fakeRandom);
+  uint32_t nowMs = 0;
+  uint32_t ceilingMs = BOUNDS.retryMs;
+  for (int failure = 1; failure <= 10; failure++) {
+    TEST_ASSERT_EQUAL(Reconnector::CONNECT_TRANSPORT, link.next(nowMs));
+    // Alternate the step that fails
+    if (failure % 2) {
+      link.onTransport(false, nowMs);
+    } else {
+      link.onTransport(true, nowMs);
+      link.onSession(false, nowMs);
+    }
+    TEST_ASSERT_EQUAL(failure, link.consecutiveFailures());
+
+    // Waits somewhere in the upper half of the window
+    uint32_t waitedMs = 0;
+    while (link.next(nowMs + waitedMs) == Reconnector::WAIT) {
+      waitedMs += 100;
+    }
+    TEST_ASSERT_TRUE(waitedMs >= ceilingMs / 2);
+    TEST_ASSERT_TRUE(waitedMs <= ceilingMs + 100);
+    nowMs += waitedMs;
+    ceilingMs = ceilingMs * 2 > BOUNDS.maxMs ? BOUNDS.maxMs : ceilingMs * 2;
+  }
+
+  // Success resets the backoff
+  link.onTransport(true, nowMs);
+  link.onSession(true, nowMs);
+  TEST_ASSERT_EQUAL(0, link.consecutiveFailures());
+  link.onLost();
+  link.onTransport(false, nowMs);
+  TEST_ASSERT_EQUAL(Reconnector::WAIT, link.next(nowMs + 400));
+  TEST_ASSERT_EQUAL(Reconnector::CONNECT_TRANSPORT, link.next(nowMs + 1000));
+}
+
+// Ten minutes on an access point that never lets the handshake through:
+// polled every 100ms like the mqtt job, it makes a few dozen attempts rather
+// than one per poll
+void test_flaky_access_point_attempt_rate() {
+  Reconnector link(BOUNDS, fakeRandom);
+  int polls = 0;
+  for (uint32_t nowMs = 0; nowMs < 600000; nowMs += 100) {
+    polls++;
+    if (link.next(nowMs) == Reconnector::CONNECT_TRANSPORT) {
+      link.onTransport(false, nowMs);
+    }
+  }
+  TEST_ASSERT_EQUAL(6000, polls);
+  TEST_ASSERT_LESS_THAN(30, link.attempts());
+  TEST_ASSERT_GREATER_THAN(8, link.attempts());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_connects_one_step_at_a_time);
+  RUN_TEST(test_failures_back_off_with_jitter);
+  RUN_TEST(test_flaky_access_point_attempt_rate);
+  return UNITY_END();
+}
@@ -0,0 +1,135 @@
+// Drives the scheduler with a fake clock
+
+#include "scheduler.h"
+#include <unity.h>
+
+static uint32_t fakeNowMs = 0;
+static uint32_t fakeClock() { return fakeNowMs; }
+
+static int tickRuns = 0;
+static int onceRuns = 0;
+static Scheduler *current = nullptr;
+static int selfId = -1;
+
+static void tick() { tickRuns++; }
+static void once() { onceRuns++; }
+static void rescheduleSelf() {
+  onceRuns++;
+  current->schedule(selfId, 250);
+}
+
+void setUp() {
+  fakeNowMs = 0;
+  tickRuns = 0;
+  onceRuns = 0;
+}
+void tearDown() {}
+
+void test_periodic_job_runs_on_period() {
+  Scheduler scheduler(fakeClock);
+  scheduler.add("tick", tick, 100);
+
+  TEST_ASSERT_EQUAL_UINT32(100, scheduler.runDue());
+  TEST_ASSERT_EQUAL(1, tickRuns);
+
+  fakeNowMs = 99;
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.runDue());
+  TEST_ASSERT_EQUAL(1, tickRuns);
+
+  fakeNowMs = 100;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(2, tickRuns);
+}
+
+void test_missed_periods_are_skipped() {
+  Scheduler scheduler(fakeClock);
+  scheduler.add("tick", tick, 100);
+  scheduler.runDue();
+
+  // A long stall runs the job once, not once per missed period
+  fakeNowMs = 1050;
+  scheduler.runDue();
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(2, tickRuns);
+
+  fakeNowMs = 1150;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(3, tickRuns);
+}
+
+void test_one_shot_job_runs_when_scheduled() {
+  Scheduler scheduler(fakeClock);
+  int id = scheduler.add("once", once, 0, Scheduler::NEVER);
+
+  TEST_ASSERT_FALSE(scheduler.isScheduled(id));
+  TEST_ASSERT_EQUAL_UINT32(5000, scheduler.runDue(5000));
+
+  scheduler.schedule(id, 300);
+  fakeNowMs = 299;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(0, onceRuns);
+
+  fakeNowMs = 300;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(1, onceRuns);
+  TEST_ASSERT_FALSE(scheduler.isScheduled(id));
+
+  scheduler.schedule(id, 10);
+  scheduler.cancel(id);
+  fakeNowMs = 400;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(1, onceRuns);
+}
+
+void test_job_can_reschedule_itself() {
+  Scheduler scheduler(fakeClock);
+  current = &scheduler;
+  selfId = scheduler.add("self", rescheduleSelf, 0);
+
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(1, onceRuns);
+  TEST_ASSERT_TRUE(scheduler.isScheduled(selfId));
+
+  fakeNowMs = 250;
+  TEST_ASSERT_EQUAL_UINT32(250, scheduler.runDue());
+  TEST_ASSERT_EQUAL(2, onceRuns);
+}
+
+void test_deadlines_survive_clock_wrap() {
+  fakeNowMs = 0xFFFFFF00;
+  Scheduler scheduler(fakeClock);
+  scheduler.add("tick", tick, 0x200);
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(1, tickRuns);
+
+  fakeNowMs = 0x000000FF;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(1, tickRuns);
+
+  fakeNowMs = 0x00000100;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL(2, tickRuns);
+}
+
+void test_lateness_is_reported() {
+  Scheduler scheduler(fakeClock);
+  scheduler.add("tick", tick, 100);
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.takeMaxLatenessMs());
+
+  fakeNowMs = 180;
+  scheduler.runDue();
+  TEST_ASSERT_EQUAL_UINT32(80, scheduler.takeMaxLatenessMs());
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.takeMaxLatenessMs());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_periodic_job_runs_on_period);
+  RUN_TEST(test_missed_periods_are_skipped);
+  RUN_TEST(test_one_shot_job_runs_when_scheduled);
+  RUN_TEST(test_job_can_reschedule_itself);
+  RUN_TEST(test_deadlines_survive_clock_wrap);
+  RUN_TEST(test_lateness_is_reported);
+  return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Stand-ins for the hardware and network the board pages run against on the
+// device: a panel that records what reaches it, a virtual clock and an HTTP
+// client that serves files. The pages themselves (board_view, text, frame)
+// are the firmware's own code.
+
+#include "frame.h"
+#include "sim_font.h"
+#include "text.h"
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+const int SIM_WIDTH = 96;
+const int SIM_HEIGHT = 48;
+
+// Fake MatrixPanel_I2S_DMA: keeps the pixels it was sent
+class FakePanel {
+public:
+  FakePanel() { clear(); }
+
+  void clear() {
+    memset(pixels, 0, sizeof(pixels));
+    linesDrawn = 0;
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if (x >= 0 && y >= 0 && x < SIM_WIDTH && y < SIM_HEIGHT) {
+      pixels[y * SIM_WIDTH + x] = color;
+    }
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    for (int16_t i = 0; i < w; i++) {
+      drawPixel(x + i, y, color);
+    }
+    linesDrawn++;
+  }
+
+  uint16_t pixel(int x, int y) const { return pixels[y * SIM_WIDTH + x]; }
+  const uint16_t *framebuffer() const { return pixels; }
+
+  uint32_t linesDrawn;
+
+private:
+  uint16_t pixels[SIM_WIDTH * SIM_HEIGHT];
+};
+
+// Binary PPM (P6), RGB565 widened to 8 bits per channel
+inline std::string encodePpm(const uint16_t *pixels, int width, int height) {
+  std::string out = "P6\n" + std::to_string(width) + " " +
+                    std::to_string(height) + "\n255\n";
+  for (int i = 0; i < width * height; i++) {
+    uint16_t c = pixels[i];
+    uint8_t r = (c >> 11) & 0x1F;
+    uint8_t g = (c >> 5) & 0x3F;
+    uint8_t b = c & 0x1F;
+    out += static_cast<char>((r << 3) | (r >> 2));
+    out += static_cast<char>((g << 2) | (g >> 4));
+    out += static_cast<char>((b << 3) | (b >> 2));
+  }
+  return out;
+}
+
+inline std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::string();
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+inline void writeFile(const std::string &path, const std::string &data) {
+  std::ofstream file(path, std::ios::binary);
+  file << data;
+}
+
+// Compare a frame with SIM_GOLDEN_DIR/<name>.ppm. With SIM_UPDATE_GOLDEN set
+// in the environment the golden is (re)written instead, after checking the
+// new frame by eye. A mismatch leaves the actual frame next to the golden as
+// <name>.actual.ppm. Returns true if the frame matches.
+inline bool matchesGolden(const char *name, const uint16_t *pixels) {
+  std::string golden = std::string(SIM_GOLDEN_DIR) + "/" + name + ".ppm";
+  std::string actual = encodePpm(pixels, SIM_WIDTH, SIM_HEIGHT);
+
+  if (getenv("SIM_UPDATE_GOLDEN")) {
+    writeFile(golden, actual);
+    printf("updated %s\n", golden.c_str());
+    return true;
+  }
+
+  std::string expected = readFile(golden);
+  if (expected == actual) {
+    return true;
+  }
+  std::string dump = std::string(SIM_GOLDEN_DIR) + "/" + name + ".actual.ppm";
+  writeFile(dump, actual);
+  printf("%s differs from %s (%s)\n", dump.c_str(), golden.c_str(),
+         expected.empty() ? "missing" : "changed");
+  return false;
+}
+
+// Stands in for millis(); usable as a Scheduler ClockFn
+struct VirtualClock {
+  static uint32_t nowMs;
+  static uint32_t now() { return nowMs; }
+  static void advance(uint32_t ms) { nowMs += ms; }
+};
+uint32_t VirtualClock::nowMs = 0;
+
+struct FakeResponse {
+  int status;
+  std::string body;
+  std::string etag;
+  std::string contentType;
+};
+
+// Fake HTTP client serving files from a directory (notes/static), with
+// ETag validation like the API server's
+class FakeHttp {
+public:
+  explicit FakeHttp(const std::string &root) : root(root) {}
+
+  // Answer GETs for path (query strings ignored) with file
+  void serve(const std::string &path, const std::string &file) {
+    routes[path] = file;
+  }
+
+  FakeResponse get(const std::string &url, const std::string &etag = "") {
+    requests++;
+    std::string path = url.substr(0, url.find('?'));
+    auto route = routes.find(path);
+    if (route == routes.end()) {
+      return {404, "not found", "", "text/plain"};
+    }
+
+    std::string body = readFile(root + "/" + route->second);
+    char tag[24];
+    snprintf(tag, sizeof(tag), "\"%016zx\"", std::hash<std::string>()(body));
+    if (etag == tag) {
+      return {304, "", tag, ""};
+    }
+    return {200, body, tag, "application/json"};
+  }
+
+  int requests = 0;
+
+private:
+  std::string root;
+  std::map<std::string, std::string> routes;
+};
+
+// The Renderer without GFX: frame, what the panel shows, text and present()
+class Simulator {
+public:
+  Simulator() : text(glyphs, frame, SIM_WIDTH, SIM_HEIGHT) {
+    buildSimGlyphs(glyphs);
+    memset(frame, 0, sizeof(frame));
+    memset(shown, 0, sizeof(shown));
+  }
+
+  void fillScreen(uint16_t color) {
+    for (int i = 0; i < SIM_WIDTH * SIM_HEIGHT; i++) {
+      frame[i] = color;
+    }
+  }
+
+  uint32_t present() {
+    return presentChanges(frame, shown, SIM_WIDTH, SIM_HEIGHT, panel);
+  }
+
+  // Write the frame to SIM_DUMP_DIR/<name>.ppm, if that is set
+  void dump(const char *name) const {
+    const char *dir = getenv("SIM_DUMP_DIR");
+    if (dir) {
+      writeFile(std::string(dir) + "/" + name + ".ppm",
+                encodePpm(frame, SIM_WIDTH, SIM_HEIGHT));
+    }
+  }
+
+  TextRenderer::Glyph glyphs[256];
+  uint16_t frame[SIM_WIDTH * SIM_HEIGHT];
+  uint16_t shown[SIM_WIDTH * SIM_HEIGHT];
+  TextRenderer text;
+  FakePanel panel;
+};
+
+#endif // SIM_H
@@ -0,0 +1,213 @@
+// Board pages in the native simulator: golden frames of the layout, what
+// reaches the panel, render cost, and a fetch served from notes/static
+
+#include "board_view.h"
+#include "departures.h"
+#include "sim.h"
+#include <chrono>
+#include <new>
+#include <unity.h>
+
+// Heap allocations, counted to check rendering doesn't allocate
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static const uint16_t RED_LINE = rgbToColor565(0xe41937);
+static const uint16_t BUS_5 = rgbToColor565(0x2da646);
+
+// Departures given in minutes from nowMs, in the middle of the minute the
+// way decodeDepartures() anchors them; negative ones have already left
+static Direction makeDirection(const char *headsign, const int *minutes,
+                               const bool *realtime, int count,
+                               uint32_t nowMs) {
+  Direction direction = {};
+  snprintf(direction.headsign, sizeof(direction.headsign), "%-6s", headsign);
+  direction.departureCount = count;
+  for (int i = 0; i < count; i++) {
+    direction.departures[i].dueMs = nowMs + minutes[i] * 60000 + 30000;
+    direction.departures[i].realtime = realtime[i];
+  }
+  return direction;
+}
+
+// Two routes like the example response: one with both directions, one
+// with a single direction led by a bus that has already left
+static void makeBoard(DepartureBoard &board, uint32_t nowMs) {
+  memset(&board, 0, sizeof(board));
+  board.routeCount = 2;
+
+  const int south[] = {0, 12, 24, 36};
+  const int north[] = {4, 16, 28, 40};
+  const bool scheduled[] = {false, false, false, false};
+  Route &red = board.routes[0];
+  snprintf(red.header, sizeof(red.header), "RED METRORail");
+  red.color = RED_LINE;
+  red.directionCount = 2;
+  red.directions[0] = makeDirection("FANNIN", south, scheduled, 4, nowMs);
+  red.directions[1] = makeDirection("NORTH", north, scheduled, 4, nowMs);
+
+  const int richey[] = {-2, 6, 43, 88};
+  const bool live[] = {true, true, false, false};
+  Route &bus = board.routes[1];
+  snprintf(bus.header, sizeof(bus.header), "5 Bus");
+  bus.color = BUS_5;
+  bus.directionCount = 1;
+  bus.directions[0] = makeDirection("RICHEY", richey, live, 4, nowMs);
+}
+
+void setUp() { VirtualClock::nowMs = 1000000; }
+void tearDown() {}
+
+void test_route_page_golden() {
+  static DepartureBoard board;
+  makeBoard(board, VirtualClock::now());
+
+  Simulator sim;
+  drawRoutePage(sim.text, board, 0, VirtualClock::now());
+  sim.dump("route_page");
+  TEST_ASSERT_TRUE(matchesGolden("route_page", sim.frame));
+}
+
+// Five minutes on, without a fetch: the minutes count down and departures
+// that left are replaced by the next stored one
+void test_route_page_counts_down_golden() {
+  static DepartureBoard board;
+  makeBoard(board, VirtualClock::now());
+  VirtualClock::advance(5 * 60000);
+
+  Simulator sim;
+  drawRoutePage(sim.text, board, 0, VirtualClock::now());
+  sim.dump("route_page_later");
+  TEST_ASSERT_TRUE(matchesGolden("route_page_later", sim.frame));
+}
+
+void test_message_page_golden() {
+  static DepartureBoard board;
+  memset(&board, 0, sizeof(board));
+  const char *lines[] = {"Red Line single", "tracking near", "Downtown TC",
+                         "until 9pm.", "Allow extra", "time.", "Thanks!"};
+  for (const char *line : lines) {
+    snprintf(board.message[board.messageLineCount++], LINE_CHARS + 1, "%s",
+             line);
+  }
+  TEST_ASSERT_EQUAL(2, messagePageCount(board));
+  TEST_ASSERT_EQUAL(15000, messagePageMs(board, 0));
+  TEST_ASSERT_EQUAL(5000, messagePageMs(board, 1));
+
+  Simulator sim;
+  drawMessagePage(sim.text, board, 0);
+  sim.dump("message_page");
+  TEST_ASSERT_TRUE(matchesGolden("message_page", sim.frame));
+}
+
+// The panel ends up showing the frame, and redrawing the same page sends
+// nothing
+void test_panel_receives_only_changes() {
+  static DepartureBoard board;
+  makeBoard(board, VirtualClock::now());
+
+  Simulator sim;
+  drawRoutePage(sim.text, board, 0, VirtualClock::now());
+  TEST_ASSERT_GREATER_THAN(0, sim.present());
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(sim.frame, sim.panel.framebuffer(),
+                                SIM_WIDTH * SIM_HEIGHT);
+
+  sim.fillScreen(0);
+  drawRoutePage(sim.text, board, 0, VirtualClock::now());
+  uint32_t lines = sim.panel.linesDrawn;
+  TEST_ASSERT_EQUAL(0, sim.present());
+  TEST_ASSERT_EQUAL(lines, sim.panel.linesDrawn);
+
+  // A minute later only the changed minute digits go out
+  VirtualClock::advance(60000);
+  sim.fillScreen(0);
+  drawRoutePage(sim.text, board, 0, VirtualClock::now());
+  uint32_t written = sim.present();
+  TEST_ASSERT_GREATER_THAN(0, written);
+  TEST_ASSERT_LESS_THAN(SIM_WIDTH * SIM_HEIGHT / 8, written);
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(sim.frame, sim.panel.framebuffer(),
+                                SIM_WIDTH * SIM_HEIGHT);
+}
+
+// Clear, draw and present a page the way runPage() does, and report what it
+// costs on the host
+void test_page_render_cost() {
+  const int pages = 2000;
+  static DepartureBoard board;
+  makeBoard(board, VirtualClock::now());
+  static Simulator sim;
+
+  size_t allocationsBefore = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < pages; i++) {
+    // Alternate minutes so every other present() has work to do
+    uint32_t nowMs = VirtualClock::now() + (i % 2) * 60000;
+    sim.fillScreen(0);
+    drawRoutePage(sim.text, board, 0, nowMs);
+    sim.present();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  TEST_ASSERT_EQUAL(0, allocations - allocationsBefore);
+  printf("page render: %.2fus, 0 allocations\n",
+         std::chrono::duration<double, std::micro>(end - start).count() /
+             pages);
+}
+
+// Fetch, decode and draw the example response, then revalidate it
+void test_fetch_from_static_files() {
+  FakeHttp http(NOTES_STATIC_DIR);
+  http.serve("/departures", "foamer-example.json");
+  static DepartureBoard board;
+
+  FakeResponse response = http.get("/departures?lat=29.7&lon=-95.4");
+  TEST_ASSERT_EQUAL(200, response.status);
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(parseDepartures(response.body, doc));
+  TEST_ASSERT_TRUE(decodeDepartures(doc, board, VirtualClock::now(), 0));
+  TEST_ASSERT_GREATER_THAN(1, board.routeCount);
+
+  // An unchanged response is a 304 with nothing to parse
+  FakeResponse again = http.get("/departures?lat=29.7&lon=-95.4", response.etag);
+  TEST_ASSERT_EQUAL(304, again.status);
+  TEST_ASSERT_EQUAL(404, http.get("/stops").status);
+  TEST_ASSERT_EQUAL(3, http.requests);
+
+  Simulator sim;
+  drawRoutePage(sim.text, board, 0, VirtualClock::now());
+  sim.present();
+  sim.dump("fetched_page");
+
+  // Each route's header is in its color, on the first line of its block
+  for (int route = 0; route < ROUTES_PER_PAGE; route++) {
+    int top = route * (1 + MAX_DIRECTIONS) * TextRenderer::CELL_HEIGHT;
+    int lit = 0;
+    for (int y = top; y < top + TextRenderer::CELL_HEIGHT; y++) {
+      for (int x = 0; x < SIM_WIDTH; x++) {
+        lit += sim.panel.pixel(x, y) == board.routes[route].color;
+      }
+    }
+    TEST_ASSERT_GREATER_THAN(0, lit);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_route_page_golden);
+  RUN_TEST(test_route_page_counts_down_golden);
+  RUN_TEST(test_message_page_golden);
+  RUN_TEST(test_panel_receives_only_changes);
+  RUN_TEST(test_page_render_cost);
+  RUN_TEST(test_fetch_from_static_files);
+  return UNITY_END();
+}
@@ -0,0 +1,148 @@
+// Departures snapshot encoding: round trip, aging and damaged data
+
+#include "snapshot_store.h"
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+static const uint32_t SAVED_MS = 600000;
+static const uint32_t SAVED_EPOCH = 1760000000;
+
+// A board decoded at SAVED_MS: one route with two directions, and a message
+static void makeBoard(DepartureBoard &board) {
+  memset(&board, 0, sizeof(board));
+  board.fetchedEpoch = SAVED_EPOCH - 30;
+  board.routeCount = 1;
+
+  Route &route = board.routes[0];
+  snprintf(route.header, sizeof(route.header), "RED METRORail");
+  route.color = rgbToColor565(0xe41937);
+  route.directionCount = 2;
+  snprintf(route.directions[0].headsign, HEADSIGN_WIDTH + 1, "FANNIN");
+  snprintf(route.directions[1].headsign, HEADSIGN_WIDTH + 1, "NORTH ");
+  for (int d = 0; d < 2; d++) {
+    Direction &direction = route.directions[d];
+    direction.departureCount = 3;
+    for (int i = 0; i < 3; i++) {
+      int minutes = d * 4 + i * 12;
+      direction.departures[i].dueMs = SAVED_MS + minutes * 60000 + 30000;
+      direction.departures[i].realtime = i == 0;
+    }
+  }
+
+  board.messageLineCount = 2;
+  snprintf(board.message[0], LINE_CHARS + 1, "Single tracking");
+  snprintf(board.message[1], LINE_CHARS + 1, "until 9pm.");
+}
+
+void setUp() {}
+void tearDown() {}
+
+// After a reboot millis() starts over; without a clock departures count
+// down from where they were when saved
+void test_round_trip_without_clock() {
+  static DepartureBoard board;
+  makeBoard(board);
+  uint8_t data[SNAPSHOT_MAX_BYTES];
+  size_t length = encodeSnapshot(board, SAVED_MS, 0, data, sizeof(data));
+  TEST_ASSERT_GREATER_THAN(0, length);
+  TEST_ASSERT_LESS_THAN(sizeof(DepartureBoard) / 8, length);
+  TEST_ASSERT_EQUAL_UINT32(0, snapshotEpoch(data, length));
+
+  static DepartureBoard restored;
+  memset(&restored, 0xAA, sizeof(restored));
+  const uint32_t bootMs = 2000;
+  TEST_ASSERT_TRUE(decodeSnapshot(data, length, restored, bootMs, 0));
+
+  TEST_ASSERT_EQUAL_UINT32(board.fetchedEpoch, restored.fetchedEpoch);
+  TEST_ASSERT_EQUAL(1, restored.routeCount);
+  const Route &route = restored.routes[0];
+  TEST_ASSERT_EQUAL_STRING("RED METRORail", route.header);
+  TEST_ASSERT_EQUAL_HEX16(board.routes[0].color, route.color);
+  TEST_ASSERT_EQUAL(2, route.directionCount);
+  TEST_ASSERT_EQUAL_STRING("NORTH ", route.directions[1].headsign);
+  TEST_ASSERT_EQUAL(3, route.directions[1].departureCount);
+  for (int i = 0; i < 3; i++) {
+    const Departure &saved = board.routes[0].directions[1].departures[i];
+    const Departure &got = route.directions[1].departures[i];
+    TEST_ASSERT_EQUAL(minutesUntil(saved, SAVED_MS),
+                      minutesUntil(got, bootMs));
+    TEST_ASSERT_EQUAL(saved.realtime, got.realtime);
+  }
+  TEST_ASSERT_EQUAL(2, restored.messageLineCount);
+  TEST_ASSERT_EQUAL_STRING("until 9pm.", restored.message[1]);
+}
+
+// With the time known at both ends, departures are aged by the time the
+// device was down, and ones that left in between read as gone
+void test_aged_by_elapsed_time() {
+  static DepartureBoard board;
+  makeBoard(board);
+  uint8_t data[SNAPSHOT_MAX_BYTES];
+  size_t length =
+      encodeSnapshot(board, SAVED_MS, SAVED_EPOCH, data, sizeof(data));
+  TEST_ASSERT_EQUAL_UINT32(SAVED_EPOCH, snapshotEpoch(data, length));
+
+  static DepartureBoard restored;
+  const uint32_t bootMs = 2000;
+  TEST_ASSERT_TRUE(decodeSnapshot(data, length, restored, bootMs,
+                                  SAVED_EPOCH + 5 * 60));
+  const Direction &south = restored.routes[0].directions[0];
+  TEST_ASSERT_EQUAL(-1, minutesUntil(south.departures[0], bootMs));
+  TEST_ASSERT_EQUAL(7, minutesUntil(south.departures[1], bootMs));
+  TEST_ASSERT_EQUAL(19, minutesUntil(south.departures[2], bootMs));
+}
+
+void test_rejects_damaged_data() {
+  static DepartureBoard board;
+  makeBoard(board);
+  uint8_t data[SNAPSHOT_MAX_BYTES];
+  size_t length = encodeSnapshot(board, SAVED_MS, 0, data, sizeof(data));
+  static DepartureBoard restored;
+
+  // Cut short anywhere
+  for (size_t cut = 0; cut < length; cut++) {
+    TEST_ASSERT_FALSE(decodeSnapshot(data, cut, restored, 0, 0));
+  }
+
+  // Another format version
+  data[1]++;
+  TEST_ASSERT_FALSE(decodeSnapshot(data, length, restored, 0, 0));
+  data[1]--;
+
+  // A count over the board's limits
+  data[10] = MAX_ROUTES + 1;
+  TEST_ASSERT_FALSE(decodeSnapshot(data, length, restored, 0, 0));
+}
+
+void test_full_board_fits_max_size() {
+  static DepartureBoard board;
+  memset(&board, 'X', sizeof(board));
+  board.routeCount = MAX_ROUTES;
+  for (Route &route : board.routes) {
+    route.header[LINE_CHARS] = '\0';
+    route.directionCount = MAX_DIRECTIONS;
+    for (Direction &direction : route.directions) {
+      direction.headsign[HEADSIGN_WIDTH] = '\0';
+      direction.departureCount = MAX_STORED_DEPARTURES;
+    }
+  }
+  board.messageLineCount = MAX_MESSAGE_LINES;
+  for (int i = 0; i < MAX_MESSAGE_LINES; i++) {
+    board.message[i][LINE_CHARS] = '\0';
+  }
+
+  static uint8_t data[SNAPSHOT_MAX_BYTES];
+  TEST_ASSERT_EQUAL(SNAPSHOT_MAX_BYTES,
+                    encodeSnapshot(board, 0, 0, data, sizeof(data)));
+  TEST_ASSERT_EQUAL(0, encodeSnapshot(board, 0, 0, data, sizeof(data) - 1));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_without_clock);
+  RUN_TEST(test_aged_by_elapsed_time);
+  RUN_TEST(test_rejects_damaged_data);
+  RUN_TEST(test_full_board_fits_max_size);
+  return UNITY_END();
+}
@@ -0,0 +1,201 @@
+// The text renderer against a model of Adafruit GFX print() with the classic
+// font, and the time to render a departure page with each
+
+#include "text.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+static const int WIDTH = 96;
+static const int HEIGHT = 48;
+
+// Stand-in for glcdfont: five column bytes per character, bit 0 at the top
+static uint8_t font[256][5];
+static TextRenderer::Glyph glyphs[256];
+
+// GFX's drawChar() followed by cursor advance, as print() does it at size 1
+// with wrapping off and a transparent background: one call per font pixel
+class GfxModel {
+public:
+  explicit GfxModel(uint16_t *buffer) : buffer(buffer) {}
+
+  __attribute__((noinline)) void writePixel(int16_t x, int16_t y,
+                                            uint16_t color) {
+    if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) {
+      return;
+    }
+    buffer[y * WIDTH + x] = color;
+  }
+
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color) {
+    if (x >= WIDTH || y >= HEIGHT || x + 5 < 0 || y + 7 < 0) {
+      return;
+    }
+    for (int i = 0; i < 5; i++) {
+      uint8_t line = font[c][i];
+      for (int j = 0; j < 8; j++, line >>= 1) {
+        if (line & 1) {
+          writePixel(x + i, y + j, color);
+        }
+      }
+    }
+  }
+
+  void setTextColor(uint16_t c) { color = c; }
+
+  void print(const char *text) {
+    for (; *text; text++) {
+      if (*text == '\n') {
+        cursorX = 0;
+        cursorY += 8;
+      } else if (*text != '\r') {
+        drawChar(cursorX, cursorY, *text, color);
+        cursorX += 6;
+      }
+    }
+  }
+
+  void print(int value) {
+    char digits[12];
+    snprintf(digits, sizeof(digits), "%d", value);
+    print(digits);
+  }
+
+  int16_t cursorX = 0;
+  int16_t cursorY = 0;
+
+private:
+  uint16_t *buffer;
+  uint16_t color = 0;
+};
+
+void setUp() {
+  // Deterministic glyph shapes that use all eight rows and five columns
+  uint32_t state = 0x2545F491;
+  for (int c = 0; c < 256; c++) {
+    for (int i = 0; i < 5; i++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      font[c][i] = state;
+    }
+  }
+
+  // What Renderer::begin() reads back from drawChar()
+  for (int c = 0; c < 256; c++) {
+    for (int y = 0; y < TextRenderer::CELL_HEIGHT; y++) {
+      uint8_t bits = 0;
+      for (int x = 0; x < 5; x++) {
+        if (font[c][x] & (1 << y)) {
+          bits |= 1 << x;
+        }
+      }
+      glyphs[c][y] = bits;
+    }
+  }
+}
+void tearDown() {}
+
+static const uint16_t WHITE = 0xFFFF;
+static const uint16_t GREEN = 0x3E0C;
+static const uint16_t ROUTE = 0xF9A0;
+
+// One board page: two routes, a header and two directions each
+template <typename Draw> void drawPage(Draw &&draw) {
+  const char *headers[] = {"Q 57 St-7 Av", "N Astoria"};
+  const char *headsigns[] = {"Coney Island", "96 St"};
+  const int minutes[] = {2, 9, 14, 23};
+  for (const char *header : headers) {
+    draw(header, ROUTE);
+    draw("\n", ROUTE);
+    for (const char *headsign : headsigns) {
+      draw("|", WHITE);
+      draw(headsign, ROUTE);
+      draw(" ", WHITE);
+      for (int i = 0; i < 4; i++) {
+        if (i > 0) {
+          draw(",", WHITE);
+        }
+        draw(minutes[i], i % 2 ? GREEN : WHITE);
+      }
+      draw("\n", WHITE);
+    }
+  }
+}
+
+static void gfxPage(uint16_t *buffer) {
+  GfxModel gfx(buffer);
+  drawPage([&](auto value, uint16_t color) {
+    gfx.setTextColor(color);
+    gfx.print(value);
+  });
+}
+
+static void textPage(uint16_t *buffer) {
+  TextRenderer text(glyphs, buffer, WIDTH, HEIGHT);
+  drawPage([&](auto value, uint16_t color) { text.print(value, color); });
+}
+
+void test_page_matches_gfx() {
+  static uint16_t want[WIDTH * HEIGHT];
+  static uint16_t got[WIDTH * HEIGHT];
+  gfxPage(want);
+  textPage(got);
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(want, got, WIDTH * HEIGHT);
+}
+
+// Partly and wholly off-screen text at every edge, numbers and line breaks
+void test_clipping_and_cursor_match_gfx() {
+  const int16_t starts[][2] = {{-9, -3}, {-6, 0},  {90, 5},  {93, 44},
+                               {0, 43},  {40, -8}, {96, 10}, {10, 48}};
+  for (const auto &start : starts) {
+    static uint16_t want[WIDTH * HEIGHT];
+    static uint16_t got[WIDTH * HEIGHT];
+    memset(want, 0, sizeof(want));
+    memset(got, 0, sizeof(got));
+
+    GfxModel gfx(want);
+    TextRenderer text(glyphs, got, WIDTH, HEIGHT);
+    gfx.cursorX = start[0];
+    gfx.cursorY = start[1];
+    text.setCursor(start[0], start[1]);
+
+    gfx.setTextColor(WHITE);
+    gfx.print("ab\r\ncd\xb1\xff");
+    gfx.print(-2147483647 - 1);
+    text.print("ab\r\ncd\xb1\xff", WHITE);
+    text.print(-2147483647 - 1, WHITE);
+
+    TEST_ASSERT_EQUAL_HEX16_ARRAY(want, got, WIDTH * HEIGHT);
+    TEST_ASSERT_EQUAL(gfx.cursorX, text.getCursorX());
+    TEST_ASSERT_EQUAL(gfx.cursorY, text.getCursorY());
+  }
+}
+
+void test_page_render_time() {
+  const int pages = 5000;
+  static uint16_t buffer[WIDTH * HEIGHT];
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < pages; i++) {
+    gfxPage(buffer);
+  }
+  auto middle = std::chrono::steady_clock::now();
+  for (int i = 0; i < pages; i++) {
+    textPage(buffer);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  using us = std::chrono::duration<double, std::micro>;
+  printf("gfx print: %.2fus per page\n", us(middle - start).count() / pages);
+  printf("text renderer: %.2fus per page\n", us(end - middle).count() / pages);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_page_matches_gfx);
+  RUN_TEST(test_clipping_and_cursor_match_gfx);
+  RUN_TEST(test_page_render_time);
+  return UNITY_END();
+}